@@ -0,0 +1,187 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include "thread_slots.hpp"
+
+namespace bits {
+
+// Thread-local count/sum/min/max pre-aggregation.
+//
+// Writers only ever touch their own slot with relaxed loads and stores
+// (no read-modify-write), bracketed by a per-slot seqlock. Count is a
+// running total per slot, acquire() reports the difference to what it saw
+// last time. Sum, min and max live in two windows selected by the parity
+// of a shared epoch that acquire() advances. A writer only restarts a
+// window once acquire() has published that it took the window's last add,
+// so nothing is lost; a writer that stalls across two acquires between
+// reading the epoch and writing has its value reported in a later window.
+// Non-finite values are summed apart from finite ones so one inf does not
+// turn every later window into NaN.
+class Aggregator {
+ public:
+  struct Summary {
+    uint64_t count = 0;
+    double sum     = 0;
+    double min     = std::numeric_limits<double>::infinity();
+    double max     = -std::numeric_limits<double>::infinity();
+
+    [[nodiscard]] bool empty() const noexcept { return count == 0; }
+  };
+
+  Aggregator()                             = default;
+  Aggregator(const Aggregator&)            = delete;
+  Aggregator& operator=(const Aggregator&) = delete;
+
+  void add(double value) {
+    slots_.local().add(value, epoch_.load(std::memory_order_relaxed));
+  }
+
+  // Single consumer.
+  Summary acquire() {
+    Summary out;
+    slots_.forEach([&](Slot& slot, bool /*orphaned*/) { slot.harvest(out); });
+    epoch_.fetch_add(1, std::memory_order_release);
+    return out;
+  }
+
+ private:
+  static constexpr uint64_t kNoWindow = std::numeric_limits<uint64_t>::max();
+
+  struct Window {
+    std::atomic<uint64_t> id{kNoWindow};
+    // Slot counts at the add that restarted the window and at the latest
+    // add; the former tells window instances apart.
+    std::atomic<uint64_t> first{0};
+    std::atomic<uint64_t> last{0};
+    std::atomic<double> sum{0};
+    // Sum of the non-finite values: 0, +inf, -inf or NaN.
+    std::atomic<double> inf{0};
+    std::atomic<double> min{0};
+    std::atomic<double> max{0};
+  };
+
+  struct Snapshot {
+    uint64_t first;
+    uint64_t last;
+    double sum;
+    double inf;
+    double min;
+    double max;
+  };
+
+  struct alignas(64) Slot {
+    // Owner thread only.
+    void add(double v, uint64_t epoch) noexcept {
+      const size_t i   = epoch & 1U;
+      auto& w          = windows[i];
+      const uint64_t s = seq.load(std::memory_order_relaxed);
+      seq.store(s + 1, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+
+      const uint64_t n = count.load(std::memory_order_relaxed) + 1;
+      count.store(n, std::memory_order_relaxed);
+
+      const bool finite = std::isfinite(v);
+      if (w.id.load(std::memory_order_relaxed) != epoch &&
+          w.last.load(std::memory_order_relaxed) ==
+              harvested[i].load(std::memory_order_relaxed)) {
+        w.id.store(epoch, std::memory_order_relaxed);
+        w.first.store(n, std::memory_order_relaxed);
+        w.sum.store(finite ? v : 0, std::memory_order_relaxed);
+        w.inf.store(finite ? 0 : v, std::memory_order_relaxed);
+        w.min.store(v, std::memory_order_relaxed);
+        w.max.store(v, std::memory_order_relaxed);
+      } else {
+        auto& acc = finite ? w.sum : w.inf;
+        acc.store(acc.load(std::memory_order_relaxed) + v,
+                  std::memory_order_relaxed);
+        w.min.store(std::min(w.min.load(std::memory_order_relaxed), v),
+                    std::memory_order_relaxed);
+        w.max.store(std::max(w.max.load(std::memory_order_relaxed), v),
+                    std::memory_order_relaxed);
+      }
+      w.last.store(n, std::memory_order_relaxed);
+
+      seq.store(s + 2, std::memory_order_release);
+    }
+
+    // Consumer only.
+    void harvest(Summary& out) {
+      uint64_t total  = 0;
+      const auto snap = read(total);
+      out.count += total - taken_count;
+      taken_count = total;
+
+      for (size_t i = 0; i < snap.size(); ++i) {
+        const auto& w = snap[i];
+        auto& t       = taken[i];
+        if (w.last == t.last) {
+          continue;
+        }
+
+        // Only what was added since the last harvest of the same window
+        // instance; the non-finite part is sticky, so it is reported
+        // again only when it changed.
+        const bool same = w.first == t.first;
+        out.sum += same ? w.sum - t.sum : w.sum;
+        if (!same || !sameClass(w.inf, t.inf)) {
+          out.sum += w.inf;
+        }
+        out.min = std::min(out.min, w.min);
+        out.max = std::max(out.max, w.max);
+        t       = w;
+        harvested[i].store(w.last, std::memory_order_relaxed);
+      }
+    }
+
+    [[nodiscard]] std::array<Snapshot, 2> read(uint64_t& total) const noexcept {
+      std::array<Snapshot, 2> snap{};
+      while (true) {
+        const uint64_t s = seq.load(std::memory_order_acquire);
+        if ((s & 1U) != 0) {
+          std::this_thread::yield();
+          continue;
+        }
+        for (size_t i = 0; i < snap.size(); ++i) {
+          const auto& w = windows[i];
+          snap[i]       = {w.first.load(std::memory_order_relaxed),
+                           w.last.load(std::memory_order_relaxed),
+                           w.sum.load(std::memory_order_relaxed),
+                           w.inf.load(std::memory_order_relaxed),
+                           w.min.load(std::memory_order_relaxed),
+                           w.max.load(std::memory_order_relaxed)};
+        }
+        total = count.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (seq.load(std::memory_order_relaxed) == s) {
+          return snap;
+        }
+      }
+    }
+
+    static bool sameClass(double a, double b) noexcept {
+      return std::isnan(a) ? std::isnan(b) : a == b;
+    }
+
+    std::atomic<uint64_t> seq{0};
+    std::atomic<uint64_t> count{0};
+    std::array<Window, 2> windows;
+    // Last add of each window the consumer has taken, written by the
+    // consumer and read by the owner before it restarts a window.
+    std::array<std::atomic<uint64_t>, 2> harvested{};
+    // Consumer-side state of the last harvest.
+    uint64_t taken_count = 0;
+    std::array<Snapshot, 2> taken{};
+  };
+
+  alignas(64) std::atomic<uint64_t> epoch_{0};
+  ThreadSlots<Slot> slots_;
+};
+
+}  // namespace bits
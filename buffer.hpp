@@ -2,94 +2,262 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <bit>
 #include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <span>
+#include <utility>
 #include <vector>
+#include "cpu.hpp"
+#include "epoch.hpp"
 
 namespace bits {
 
-constexpr size_t kSlots = (1 << 10);
-constexpr size_t kMask  = kSlots - 1;
+constexpr size_t kSlots     = (1 << 10);
+constexpr size_t kIdleFlips = 64;
 
+// A full slot array no longer overwrites older values: appends past the end
+// go to a mutex-protected overflow segment (up to `overflow` values per
+// window) and are counted as dropped beyond that.
 template <typename T>
 struct alignas(64) Wrap {
-  Wrap()                       = default;
+  Wrap(size_t slots, size_t overflow)
+      : values_(std::make_unique<T[]>(slots)),
+        slots_(slots),
+        overflow_(overflow) {}
   Wrap(const Wrap&)            = delete;
   Wrap& operator=(const Wrap&) = delete;
 
-  void append(const T& v) noexcept {
-    const size_t idx = write_.fetch_add(1, std::memory_order_release) & kMask;
-    values_[idx]     = v;
+  // Returns the write position, positions >= slots_ spilled or dropped.
+  size_t append(const T& v) {
+    const size_t idx = write_.fetch_add(1, std::memory_order_release);
+    if (idx < slots_) [[likely]] {
+      values_[idx] = v;
+    } else {
+      spill(v);
+    }
+    return idx;
   }
 
-  size_t drainInto(std::vector<T>& out) noexcept {
+  size_t drainInto(std::vector<T>& out, size_t& dropped) {
     const size_t wrote = write_.exchange(0, std::memory_order_acq_rel);
-    if (wrote == 0U) {
-      return 0;
+    const size_t n     = std::min<size_t>(wrote, slots_);
+    out.insert(out.end(), values_.get(), values_.get() + n);
+
+    size_t spilled = 0;
+    if (overflow_ != 0) {
+      std::unique_lock lock(spill_mutex_);
+      spilled = spill_.size();
+      out.insert(out.end(), spill_.begin(), spill_.end());
+      spill_.clear();
     }
-    const size_t n     = std::min<size_t>(wrote, kSlots);
-    const size_t end   = (wrote - 1) & kMask;
-    const size_t start = (wrote - n) & kMask;
-    if (start <= end) {
-      out.insert(out.end(), values_.begin() + start, values_.begin() + end + 1);
-    } else {
-      out.insert(out.end(), values_.begin() + start, values_.end());
-      out.insert(out.end(), values_.begin(), values_.begin() + end + 1);
+    dropped += dropped_.exchange(0, std::memory_order_relaxed);
+    return n + spilled;
+  }
+
+  void spill(const T& v) {
+    if (overflow_ != 0) {
+      std::unique_lock lock(spill_mutex_);
+      if (spill_.size() < overflow_) {
+        spill_.push_back(v);
+        return;
+      }
     }
-    return n;
+    dropped_.fetch_add(1, std::memory_order_relaxed);
   }
 
-  std::array<T, kSlots> values_{};
+  std::unique_ptr<T[]> values_;
+  size_t slots_;
+  size_t overflow_;
   std::atomic<size_t> write_{0};
+  std::atomic<size_t> dropped_{0};
+  std::mutex spill_mutex_;
+  std::vector<T> spill_;
 };
 
 template <typename T>
 struct alignas(64) Shard {
+  Shard(size_t slots, size_t overflow)
+      : buffers_{Wrap<T>(slots, overflow), Wrap<T>(slots, overflow)} {}
+
   Wrap<T> buffers_[2];
   std::atomic<unsigned> current_{0};
+  // Consumer-only: consecutive flips that drained nothing.
+  size_t idle_{0};
 
-  void append(const T& v) noexcept {
+  size_t append(const T& v) {
     const unsigned curr = current_.load(std::memory_order_acquire) & 1U;
-    buffers_[curr].append(v);
+    return buffers_[curr].append(v);
   }
 
-  void flip(std::vector<T>& out) noexcept {
+  size_t flip(std::vector<T>& out, size_t& dropped) {
     const unsigned prev =
         current_.fetch_xor(1U, std::memory_order_acq_rel) & 1U;
     auto& old = buffers_[prev];
-    old.drainInto(out);
+    return old.drainInto(out, dropped);
   }
 };
 
+struct MPSCBufferOptions {
+  // Per shard and window, rounded up to a power of 2.
+  size_t slots = kSlots;
+  // Empty acquires before a shard is released, 0 keeps shards forever.
+  size_t idle_flips = kIdleFlips;
+  ShardPolicy policy = ShardPolicy::Thread;
+  // Values a full shard may spill per window before it starts dropping.
+  size_t overflow = 0;
+};
+
+// Shards are allocated on first append from a thread that maps to them and
+// released again after `idle_flips` consecutive empty acquires, so memory
+// follows the number of active writers rather than `Shards`.
+//
+// With `ShardPolicy::Cpu` writers pick the shard of the CPU they run on and
+// the shard count is the online CPU count (rounded up to a power of 2), so
+// contention is bounded by cores rather than by thread count.
+//
+// Appends are pinned in an EpochDomain while shards can be released, which
+// costs a plain store where membarrier(2) exists. A released shard is
+// unlinked first, drained by every acquire meanwhile, and only freed once
+// no writer that might still hold it is pinned.
+//
+// The pressure callback runs on the writer that fills a shard to 3/4 of
+// its slots, once per shard and window, so the consumer can flush early.
 template <typename T, size_t Shards = 64>
 class MPSCBuffer {
  public:
-  MPSCBuffer() { scratch_.reserve(Shards * kSlots); }
+  explicit MPSCBuffer(MPSCBufferOptions options = {})
+      : slots_(std::bit_ceil(std::max<size_t>(options.slots, 1))),
+        high_water_(slots_ - slots_ / 4),
+        idle_flips_(options.idle_flips),
+        overflow_(options.overflow),
+        policy_(options.policy),
+        count_(options.policy == ShardPolicy::Cpu
+                   ? std::bit_ceil(onlineCpus())
+                   : Shards),
+        shards_(std::make_unique<std::atomic<Shard<T>*>[]>(count_)) {}
+
+  ~MPSCBuffer() {
+    // No writer may be appending any more; frees every retired shard.
+    epoch_.reclaim();
+    for (auto& slot : std::span(shards_.get(), count_)) {
+      delete slot.load(std::memory_order_relaxed);
+    }
+  }
 
   MPSCBuffer(const MPSCBuffer&)            = delete;
   MPSCBuffer& operator=(const MPSCBuffer&) = delete;
 
-  void append(const T& v) noexcept {
-    const auto& idx = shard_id_ & (Shards - 1);
-    shards_[idx].append(v);
+  // Not thread-safe, set before the first append.
+  void onPressure(std::function<void()> fn) { on_pressure_ = std::move(fn); }
+
+  void append(const T& v) {
+    if (idle_flips_ == 0) {
+      // Shards are never freed, nothing to pin.
+      appendTo(v);
+      return;
+    }
+    const auto guard = epoch_.pin();
+    appendTo(v);
   }
 
-  std::span<const T> acquire() noexcept {
+  std::span<const T> acquire() {
     scratch_.clear();
-    for (auto& s : shards_) {
-      s.flip(scratch_);
+    dropped_    = 0;
+    size_t live = 0;
+    for (auto& slot : std::span(shards_.get(), count_)) {
+      auto* shard = slot.load(std::memory_order_acquire);
+      if (shard == nullptr) {
+        continue;
+      }
+
+      if (shard->flip(scratch_, dropped_) != 0) {
+        shard->idle_ = 0;
+      } else if (idle_flips_ != 0 && ++shard->idle_ >= idle_flips_) {
+        slot.store(nullptr, std::memory_order_seq_cst);
+        retired_.push_back(shard);
+        epoch_.retire([this, shard] {
+          // Pinned writers are gone; take what they left and free it.
+          shard->flip(scratch_, dropped_);
+          shard->flip(scratch_, dropped_);
+          std::erase(retired_, shard);
+          delete shard;
+        });
+        continue;
+      }
+      live++;
+    }
+
+    reclaim();
+
+    if (live == 0 && retired_.empty() && scratch_.empty()) {
+      std::vector<T>().swap(scratch_);
     }
     return {scratch_.data(), scratch_.size()};
   }
 
+  // Values dropped during the window returned by the last acquire().
+  [[nodiscard]] size_t dropped() const noexcept { return dropped_; }
+
+  // Number of currently allocated shards.
+  [[nodiscard]] size_t shards() const noexcept {
+    const auto live = [](const auto& slot) {
+      return slot.load(std::memory_order_relaxed) != nullptr;
+    };
+    return static_cast<size_t>(
+        std::ranges::count_if(std::span(shards_.get(), count_), live));
+  }
+
+  [[nodiscard]] size_t slots() const noexcept { return slots_; }
+
+  // Number of shards writers are spread over.
+  [[nodiscard]] size_t capacity() const noexcept { return count_; }
+
  private:
-  static inline thread_local size_t shard_id_ = [] {
-    static std::atomic<size_t> ctr{0};
-    return ctr.fetch_add(1, std::memory_order_relaxed);
-  }();
+  void appendTo(const T& v) {
+    auto& slot  = shards_[shardIndex(policy_) & (count_ - 1)];
+    auto* shard = slot.load(std::memory_order_seq_cst);
+    if (shard == nullptr) [[unlikely]] {
+      shard = materialize(slot);
+    }
+    if (shard->append(v) == high_water_ && on_pressure_) [[unlikely]] {
+      on_pressure_();
+    }
+  }
+
+  Shard<T>* materialize(std::atomic<Shard<T>*>& slot) {
+    auto fresh         = std::make_unique<Shard<T>>(slots_, overflow_);
+    Shard<T>* expected = nullptr;
+    if (slot.compare_exchange_strong(expected, fresh.get(),
+                                     std::memory_order_acq_rel)) {
+      return fresh.release();
+    }
+    return expected;
+  }
+
+  void reclaim() {
+    for (auto* shard : retired_) {
+      shard->flip(scratch_, dropped_);
+      shard->flip(scratch_, dropped_);
+    }
+    epoch_.reclaim();
+  }
 
+  size_t slots_;
+  size_t high_water_;
+  size_t idle_flips_;
+  size_t overflow_;
+  ShardPolicy policy_;
+  size_t count_;
+  size_t dropped_{0};
+  std::function<void()> on_pressure_;
   std::vector<T> scratch_;
-  std::array<Shard<T>, Shards> shards_;
+  // Unlinked shards not yet freed by epoch_.
+  std::vector<Shard<T>*> retired_;
+  std::unique_ptr<std::atomic<Shard<T>*>[]> shards_;
+  EpochDomain epoch_;
 };
 
 }  // namespace bits
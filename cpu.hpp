@@ -0,0 +1,64 @@
+#pragma once
+
+#include <sched.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h>
+#endif
+
+namespace bits {
+
+enum class ShardPolicy : uint8_t {
+  // Process-wide thread index, fixed for the thread's lifetime.
+  Thread = 0,
+  // CPU the caller currently runs on.
+  Cpu = 1,
+};
+
+inline size_t onlineCpus() noexcept {
+  const long n = ::sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? static_cast<size_t>(n) : 1;
+}
+
+inline size_t threadIndex() noexcept {
+  static thread_local const size_t idx = [] {
+    static std::atomic<size_t> ctr{0};
+    return ctr.fetch_add(1, std::memory_order_relaxed);
+  }();
+  return idx;
+}
+
+// Reads the cpu_id glibc keeps in the thread's rseq area (one load, no
+// syscall). Falls back to sched_getcpu() refreshed every kCpuRefresh calls
+// where rseq is not registered.
+inline size_t currentCpu() noexcept {
+#if defined(RSEQ_SIG)
+  if (__rseq_size != 0) {
+    const auto* rs = reinterpret_cast<const volatile struct rseq*>(
+        static_cast<char*>(__builtin_thread_pointer()) + __rseq_offset);
+    const auto cpu = static_cast<int32_t>(rs->cpu_id);
+    if (cpu >= 0) {
+      return static_cast<size_t>(cpu);
+    }
+  }
+#endif
+
+  constexpr unsigned kCpuRefresh = 64;
+  static thread_local unsigned calls = 0;
+  static thread_local size_t cpu     = 0;
+  if (calls++ % kCpuRefresh == 0) {
+    const int c = ::sched_getcpu();
+    cpu         = c >= 0 ? static_cast<size_t>(c) : threadIndex();
+  }
+  return cpu;
+}
+
+inline size_t shardIndex(ShardPolicy policy) noexcept {
+  return policy == ShardPolicy::Cpu ? currentCpu() : threadIndex();
+}
+
+}  // namespace bits
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <mutex>
+#include <utility>
+#include <vector>
+#include "thread_slots.hpp"
+
+#if __has_include(<linux/membarrier.h>)
+#include <linux/membarrier.h>
+#include <sys/syscall.h>
+#endif
+
+namespace bits {
+
+namespace detail {
+
+// membarrier(2) runs a full fence on every thread of the process that is
+// currently on a CPU, which lets readers skip their own. Registered once;
+// false where the kernel lacks private expedited membarrier.
+inline bool heavyBarrierAvailable() noexcept {
+#if __has_include(<linux/membarrier.h>)
+  static const bool ok =
+      ::syscall(__NR_membarrier, MEMBARRIER_CMD_REGISTER_PRIVATE_EXPEDITED, 0,
+                0) == 0;
+  return ok;
+#else
+  return false;
+#endif
+}
+
+inline void heavyBarrier() noexcept {
+#if __has_include(<linux/membarrier.h>)
+  ::syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+#endif
+}
+
+}  // namespace detail
+
+// Epoch-based reclamation for data published through an atomic pointer.
+// Readers pin() around their accesses: one thread_local slot lookup and
+// a store, no shared writes. A writer swaps in the new version, retire()s
+// the old one and later calls reclaim(), which frees whatever was retired
+// before every currently pinned reader started.
+//
+// Where membarrier(2) is available the pin is a plain store and reclaim()
+// pays for the store-load fence instead; otherwise the pin is seq_cst.
+// Readers must load the published pointer after pin() with (at least)
+// seq_cst, and writers must store it with seq_cst before retire().
+class EpochDomain {
+ public:
+  class Guard {
+   public:
+    explicit Guard(EpochDomain& domain) : domain_(&domain) { domain_->enter(); }
+    ~Guard() {
+      if (domain_ != nullptr) {
+        domain_->exit();
+      }
+    }
+
+    Guard(Guard&& other) noexcept : domain_(std::exchange(other.domain_, nullptr)) {}
+    Guard(const Guard&)            = delete;
+    Guard& operator=(const Guard&) = delete;
+    Guard& operator=(Guard&&)      = delete;
+
+   private:
+    EpochDomain* domain_;
+  };
+
+  EpochDomain() : asymmetric_(detail::heavyBarrierAvailable()) {}
+  ~EpochDomain() {
+    // No reader may be pinned any more.
+    for (auto& [epoch, free] : retired_) {
+      free();
+    }
+  }
+
+  EpochDomain(const EpochDomain&)            = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // Pins may nest within a thread.
+  [[nodiscard]] Guard pin() { return Guard(*this); }
+
+  void retire(std::function<void()> free) {
+    const uint64_t epoch = epoch_.fetch_add(1, std::memory_order_seq_cst) + 1;
+    std::unique_lock lock(mutex_);
+    retired_.emplace_back(epoch, std::move(free));
+  }
+
+  template <typename T>
+  void retire(const T* p) {
+    retire([p] { delete p; });
+  }
+
+  // Frees what no pinned reader can still reach; returns what is left.
+  size_t reclaim() {
+    {
+      std::unique_lock lock(mutex_);
+      if (retired_.empty()) {
+        return 0;
+      }
+    }
+    if (asymmetric_) {
+      // Pairs with the fenceless store in enter(): afterwards every pin
+      // that raced with the swap is visible below.
+      detail::heavyBarrier();
+    }
+
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    slots_.forEach([&](Slot& slot, bool /*orphaned*/) {
+      const uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+      if (epoch != 0) {
+        oldest = std::min(oldest, epoch);
+      }
+    });
+
+    std::vector<std::function<void()>> ready;
+    {
+      std::unique_lock lock(mutex_);
+      std::erase_if(retired_, [&](auto& entry) {
+        // Readers pinned at or after the retire epoch started after the
+        // swap and only see the new version.
+        if (entry.first > oldest) {
+          return false;
+        }
+        ready.push_back(std::move(entry.second));
+        return true;
+      });
+    }
+    for (auto& free : ready) {
+      free();
+    }
+
+    std::unique_lock lock(mutex_);
+    return retired_.size();
+  }
+
+ private:
+  struct Slot {
+    // Epoch at the outermost pin(), 0 when not pinned.
+    std::atomic<uint64_t> epoch{0};
+    // Owning thread only.
+    uint32_t depth{0};
+  };
+
+  void enter() {
+    auto& slot = slots_.local();
+    if (slot.depth++ == 0) {
+      if (asymmetric_) {
+        slot.epoch.store(epoch_.load(std::memory_order_acquire),
+                         std::memory_order_relaxed);
+        std::atomic_signal_fence(std::memory_order_seq_cst);
+      } else {
+        slot.epoch.store(epoch_.load(std::memory_order_seq_cst),
+                         std::memory_order_seq_cst);
+      }
+    }
+  }
+
+  void exit() {
+    auto& slot = slots_.local();
+    if (--slot.depth == 0) {
+      slot.epoch.store(0, std::memory_order_release);
+    }
+  }
+
+  const bool asymmetric_;
+  std::atomic<uint64_t> epoch_{1};
+  ThreadSlots<Slot> slots_;
+  std::mutex mutex_;
+  std::vector<std::pair<uint64_t, std::function<void()>>> retired_;
+};
+
+}  // namespace bits
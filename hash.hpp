@@ -1,6 +1,11 @@
 #pragma once
 
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <span>
 
 namespace bits {
 template <class T>
@@ -20,4 +25,52 @@ struct Hash<std::pair<T1, T2>> {
     return h1 ^ (h2 << 1);
   }
 };
+
+namespace detail {
+// Slicing-by-8 tables for CRC-32C (Castagnoli, reflected 0x82F63B78),
+// the word loop below assumes a little-endian host.
+constexpr std::array<std::array<uint32_t, 256>, 8> makeCrc32cTables() {
+  std::array<std::array<uint32_t, 256>, 8> t{};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t c = i;
+    for (int k = 0; k < 8; ++k) {
+      c = (c & 1U) != 0 ? (c >> 1) ^ 0x82F63B78U : c >> 1;
+    }
+    t[0][i] = c;
+  }
+  for (size_t s = 1; s < 8; ++s) {
+    for (uint32_t i = 0; i < 256; ++i) {
+      t[s][i] = (t[s - 1][i] >> 8) ^ t[0][t[s - 1][i] & 0xFFU];
+    }
+  }
+  return t;
+}
+
+inline constexpr auto kCrc32c = makeCrc32cTables();
+}  // namespace detail
+
+// CRC-32C of `data`, `crc` continues a previous call.
+inline uint32_t crc32c(std::span<const std::byte> data,
+                       uint32_t crc = 0) noexcept {
+  const auto& t = detail::kCrc32c;
+  const auto* p = reinterpret_cast<const uint8_t*>(data.data());
+  size_t n      = data.size();
+  crc           = ~crc;
+
+  while (n >= 8) {
+    uint64_t v;
+    std::memcpy(&v, p, sizeof(v));
+    v ^= crc;
+    crc = t[7][v & 0xFFU] ^ t[6][(v >> 8) & 0xFFU] ^
+          t[5][(v >> 16) & 0xFFU] ^ t[4][(v >> 24) & 0xFFU] ^
+          t[3][(v >> 32) & 0xFFU] ^ t[2][(v >> 40) & 0xFFU] ^
+          t[1][(v >> 48) & 0xFFU] ^ t[0][v >> 56];
+    p += 8;
+    n -= 8;
+  }
+  while (n-- != 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFFU];
+  }
+  return ~crc;
+}
 }  // namespace bits
\ No newline at end of file
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <span>
+#include <thread>
+#include "cpu.hpp"
+
+namespace bits {
+
+// DDSketch: relative-error, mergeable quantile sketch.
+// https://arxiv.org/abs/1908.10693
+//
+// Any quantile is reported within `Alpha` relative error as long as the
+// populated range fits into `Bins` log-buckets, i.e. max/min below
+// ((1 + Alpha) / (1 - Alpha))^Bins (~7e8 for the defaults). Wider ranges
+// collapse the lowest buckets, so memory stays flat at the cost of the
+// low quantiles.
+template <size_t Bins = 512, double Alpha = 0.02>
+  requires(Bins > 1 && Alpha > 0.0 && Alpha < 1.0)
+class DDSketch {
+ public:
+  // NaN and +-inf have no bucket and are ignored.
+  void add(double value) noexcept {
+    if (!std::isfinite(value)) {
+      return;
+    }
+
+    if (value > kMinIndexable) {
+      positive_.add(key(value), 1);
+    } else if (value < -kMinIndexable) {
+      negative_.add(key(-value), 1);
+    } else {
+      zero_++;
+    }
+
+    count_++;
+    sum_ += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void merge(const DDSketch& other) noexcept {
+    if (other.count_ == 0) {
+      return;
+    }
+
+    positive_.merge(other.positive_);
+    negative_.merge(other.negative_);
+    zero_ += other.zero_;
+    count_ += other.count_;
+    sum_ += other.sum_;
+    min_ = std::min(min_, other.min_);
+    max_ = std::max(max_, other.max_);
+  }
+
+  void clear() noexcept {
+    positive_.clear();
+    negative_.clear();
+    zero_  = 0;
+    count_ = 0;
+    sum_   = 0;
+    min_   = std::numeric_limits<double>::infinity();
+    max_   = -std::numeric_limits<double>::infinity();
+  }
+
+  [[nodiscard]] double quantile(double q) const noexcept {
+    if (count_ == 0) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+
+    q                   = std::clamp(q, 0.0, 1.0);
+    const uint64_t rank = static_cast<uint64_t>(
+        q * static_cast<double>(count_ - 1));
+
+    double result = 0;
+    if (rank < negative_.total) {
+      // Negative values are stored by magnitude, walk them from the top.
+      result = -value(negative_.keyAtRank(negative_.total - 1 - rank));
+    } else if (rank < negative_.total + zero_) {
+      result = 0;
+    } else {
+      result = value(positive_.keyAtRank(rank - negative_.total - zero_));
+    }
+    return std::clamp(result, min_, max_);
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return count_ == 0; }
+  [[nodiscard]] uint64_t count() const noexcept { return count_; }
+  [[nodiscard]] double sum() const noexcept { return sum_; }
+  [[nodiscard]] double min() const noexcept { return min_; }
+  [[nodiscard]] double max() const noexcept { return max_; }
+
+ private:
+  static constexpr double kMinIndexable = 1e-9;
+
+  static inline const double kGamma    = (1.0 + Alpha) / (1.0 - Alpha);
+  static inline const double kLogGamma = std::log(kGamma);
+
+  [[nodiscard]] static int32_t key(double value) noexcept {
+    return static_cast<int32_t>(std::ceil(std::log(value) / kLogGamma));
+  }
+
+  [[nodiscard]] static double value(int32_t key) noexcept {
+    return 2.0 * std::pow(kGamma, key) / (kGamma + 1.0);
+  }
+
+  // Dense window of `Bins` counters over keys [offset, offset + Bins).
+  // Keys below the window are folded into the first bucket.
+  struct Store {
+    std::array<uint64_t, Bins> counts{};
+    int32_t offset = 0;
+    int32_t lo     = 0;
+    int32_t hi     = 0;
+    uint64_t total = 0;
+
+    void add(int32_t k, uint64_t n) noexcept {
+      if (total == 0) {
+        offset = k - static_cast<int32_t>(Bins / 2);
+        lo     = k;
+        hi     = k;
+      }
+
+      if (k < offset) {
+        if (static_cast<int64_t>(hi) - k < static_cast<int64_t>(Bins)) {
+          shift(k);
+        } else {
+          k = offset;
+        }
+      } else if (k >= offset + static_cast<int32_t>(Bins)) {
+        shift(k - static_cast<int32_t>(Bins) + 1);
+      }
+
+      counts[k - offset] += n;
+      lo = std::min(lo, k);
+      hi = std::max(hi, k);
+      total += n;
+    }
+
+    void merge(const Store& other) noexcept {
+      if (other.total == 0) {
+        return;
+      }
+      for (int32_t k = other.lo; k <= other.hi; ++k) {
+        const uint64_t n = other.counts[k - other.offset];
+        if (n != 0) {
+          add(k, n);
+        }
+      }
+    }
+
+    void clear() noexcept {
+      if (total != 0) {
+        std::fill(counts.begin() + (lo - offset),
+                  counts.begin() + (hi - offset) + 1, 0);
+      }
+      total = 0;
+    }
+
+    [[nodiscard]] int32_t keyAtRank(uint64_t rank) const noexcept {
+      uint64_t seen = 0;
+      for (int32_t k = lo; k <= hi; ++k) {
+        seen += counts[k - offset];
+        if (seen > rank) {
+          return k;
+        }
+      }
+      return hi;
+    }
+
+    void shift(int32_t next) noexcept {
+      const int64_t delta = static_cast<int64_t>(next) - offset;
+      if (delta > 0) {
+        const auto d        = static_cast<size_t>(std::min<int64_t>(delta, Bins));
+        uint64_t collapsed  = 0;
+        for (size_t i = 0; i < d; ++i) {
+          collapsed += counts[i];
+        }
+        std::copy(counts.begin() + d, counts.end(), counts.begin());
+        std::fill(counts.end() - d, counts.end(), 0);
+        counts[0] += collapsed;
+        lo = std::max(lo, next);
+        hi = std::max(hi, next);
+      } else if (delta < 0) {
+        const auto d = static_cast<size_t>(-delta);
+        std::copy_backward(counts.begin(), counts.end() - d, counts.end());
+        std::fill(counts.begin(), counts.begin() + d, 0);
+      }
+      offset = next;
+    }
+  };
+
+  Store positive_;
+  Store negative_;
+  uint64_t zero_  = 0;
+  uint64_t count_ = 0;
+  double sum_     = 0;
+  double min_     = std::numeric_limits<double>::infinity();
+  double max_     = -std::numeric_limits<double>::infinity();
+};
+
+// Sharded sketch with the same append/acquire shape as MPSCBuffer: writers
+// fold values into their shard under a (mostly uncontended) spin lock, the
+// single consumer merges and resets all shards.
+template <typename Sketch = DDSketch<>, size_t Shards = 16>
+class MPSCSketch {
+ public:
+  explicit MPSCSketch(ShardPolicy policy = ShardPolicy::Thread)
+      : policy_(policy),
+        count_(policy == ShardPolicy::Cpu ? std::bit_ceil(onlineCpus())
+                                          : Shards),
+        shards_(std::make_unique<Shard[]>(count_)) {}
+
+  MPSCSketch(const MPSCSketch&)            = delete;
+  MPSCSketch& operator=(const MPSCSketch&) = delete;
+
+  void append(double v) noexcept {
+    auto& shard = shards_[shardIndex(policy_) & (count_ - 1)];
+    shard.lock();
+    shard.sketch.add(v);
+    shard.unlock();
+  }
+
+  const Sketch& acquire() noexcept {
+    merged_.clear();
+    for (auto& shard : std::span(shards_.get(), count_)) {
+      shard.lock();
+      merged_.merge(shard.sketch);
+      shard.sketch.clear();
+      shard.unlock();
+    }
+    return merged_;
+  }
+
+ private:
+  struct alignas(64) Shard {
+    void lock() noexcept {
+      while (busy.test_and_set(std::memory_order_acquire)) {
+        while (busy.test(std::memory_order_relaxed)) {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    void unlock() noexcept { busy.clear(std::memory_order_release); }
+
+    std::atomic_flag busy;
+    Sketch sketch;
+  };
+
+  ShardPolicy policy_;
+  size_t count_;
+  Sketch merged_;
+  std::unique_ptr<Shard[]> shards_;
+};
+
+}  // namespace bits
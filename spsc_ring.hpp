@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+
+namespace bits {
+
+// Single-producer/single-consumer ring of variable-sized byte records.
+//
+// A record is [u32 len][len bytes] and never wraps; when it does not fit
+// before the end, the producer pads the rest of the buffer (a u32 marker
+// if there is room for one) and starts over at offset 0. Positions are
+// monotonic byte offsets; the producer publishes with one release store
+// of `head_`, the consumer frees space with one release store of `tail_`.
+// Each side caches the other's position and only reloads it when the
+// cached value says the ring is full (or empty).
+//
+// Lossy mode: the producer may also evict() the oldest record to make
+// room. The consumer of such a ring must use take() instead of
+// front()/pop()/release(); take() copies a record out and then claims it
+// with a CAS on `tail_`, discarding the copy if the producer got there
+// first.
+class SPSCByteRing {
+ public:
+  SPSCByteRing() = default;
+  // `capacity` is rounded up to a power of two.
+  explicit SPSCByteRing(size_t capacity) { init(capacity); }
+
+  SPSCByteRing(const SPSCByteRing&)            = delete;
+  SPSCByteRing& operator=(const SPSCByteRing&) = delete;
+
+  // Called once, by the producer, on a ring created empty. The consumer
+  // may poll ready() concurrently.
+  void init(size_t capacity) {
+    capacity_ = std::bit_ceil(std::max<size_t>(capacity, 64));
+    data_     = std::make_unique<std::byte[]>(capacity_);
+    ready_.store(true, std::memory_order_release);
+  }
+
+  [[nodiscard]] bool ready() const noexcept {
+    return ready_.load(std::memory_order_acquire);
+  }
+  [[nodiscard]] size_t capacity() const noexcept { return capacity_; }
+  // Largest record reserve() accepts. Framed records are capped at half
+  // the buffer so that, together with the padding in front of them, they
+  // always fit once the ring is drained.
+  [[nodiscard]] size_t maxRecord() const noexcept {
+    return capacity_ / 2 - kHeader;
+  }
+
+  // Producer: space for a `size`-byte record, or nullptr when it does not
+  // fit right now. Nothing is visible to the consumer before commit().
+  std::byte* reserve(size_t size) noexcept {
+    const size_t need = kHeader + size;
+    if (need > capacity_ / 2) {
+      return nullptr;
+    }
+
+    uint64_t head    = head_.load(std::memory_order_relaxed);
+    const size_t off = head & (capacity_ - 1);
+    const size_t pad = off + need > capacity_ ? capacity_ - off : 0;
+    if (!fits(head, pad + need)) {
+      return nullptr;
+    }
+
+    if (pad != 0) {
+      if (pad >= kHeader) {
+        std::memcpy(data_.get() + off, &kPad, kHeader);
+      }
+      head += pad;
+    }
+    reserved_ = head;
+    auto* p   = data_.get() + (head & (capacity_ - 1));
+    const auto len = static_cast<uint32_t>(size);
+    std::memcpy(p, &len, kHeader);
+    return p + kHeader;
+  }
+
+  // Producer: publishes the record from the last reserve().
+  void commit(size_t size) noexcept {
+    head_.store(reserved_ + kHeader + size, std::memory_order_release);
+  }
+
+  // Producer, lossy mode: drops the oldest record. False if the ring is
+  // empty.
+  bool evict() noexcept {
+    uint64_t tail       = tail_.load(std::memory_order_acquire);
+    const uint64_t head = head_.load(std::memory_order_relaxed);
+    while (tail != head) {
+      bool pad          = false;
+      const uint64_t to = tail + extent(tail, pad);
+      if (tail_.compare_exchange_weak(tail, to, std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+        tail_cache_ = to;
+        // Orders the claim before any overwrite of the evicted bytes; pairs
+        // with the fence in take().
+        std::atomic_thread_fence(std::memory_order_release);
+        if (!pad) {
+          return true;
+        }
+        tail = to;
+      }
+    }
+    return false;
+  }
+
+  // Consumer, lossy mode: moves the front record into `out` and pops it.
+  // False when the ring is empty.
+  template <typename Buffer>
+  bool take(Buffer& out) {
+    while (true) {
+      uint64_t tail       = tail_.load(std::memory_order_acquire);
+      const uint64_t head = head_.load(std::memory_order_acquire);
+      if (tail == head) {
+        return false;
+      }
+
+      bool pad          = false;
+      const size_t size = extent(tail, pad);
+      if (size > capacity_ - (tail & (capacity_ - 1))) {
+        // A length torn by a concurrent eviction.
+        continue;
+      }
+      if (!pad) {
+        const auto* p = data_.get() + (tail & (capacity_ - 1)) + kHeader;
+        out.assign(reinterpret_cast<const typename Buffer::value_type*>(p),
+                   reinterpret_cast<const typename Buffer::value_type*>(p) +
+                       (size - kHeader));
+      }
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (tail_.compare_exchange_strong(tail, tail + size,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire) &&
+          !pad) {
+        return true;
+      }
+    }
+  }
+
+  // Bytes in use, as seen by the producer.
+  [[nodiscard]] size_t used() const noexcept {
+    return head_.load(std::memory_order_relaxed) -
+           tail_.load(std::memory_order_acquire);
+  }
+
+  // Consumer: front record, empty when there is none.
+  [[nodiscard]] std::span<const std::byte> front() noexcept {
+    while (true) {
+      if (read_ == head_cache_) {
+        head_cache_ = head_.load(std::memory_order_acquire);
+        if (read_ == head_cache_) {
+          return {};
+        }
+      }
+
+      const size_t off = read_ & (capacity_ - 1);
+      if (capacity_ - off < kHeader) {
+        read_ += capacity_ - off;
+        continue;
+      }
+      uint32_t len = 0;
+      std::memcpy(&len, data_.get() + off, kHeader);
+      if (len == kPad) {
+        read_ += capacity_ - off;
+        continue;
+      }
+      return {data_.get() + off + kHeader, len};
+    }
+  }
+
+  // Consumer: drops the front record. Space is handed back to the
+  // producer by release() so a drain costs one store.
+  void pop(std::span<const std::byte> record) noexcept {
+    read_ += kHeader + record.size();
+  }
+
+  // Consumer: hands everything popped so far back to the producer.
+  void release() noexcept { tail_.store(read_, std::memory_order_release); }
+
+ private:
+  static constexpr size_t kHeader = sizeof(uint32_t);
+  static constexpr uint32_t kPad  = 0xffffffff;
+
+  // Bytes from `pos` to the next record: a whole record, or the padding
+  // up to the end of the buffer.
+  size_t extent(uint64_t pos, bool& pad) const noexcept {
+    const size_t off = pos & (capacity_ - 1);
+    uint32_t len     = kPad;
+    if (capacity_ - off >= kHeader) {
+      std::memcpy(&len, data_.get() + off, kHeader);
+    }
+    pad = len == kPad;
+    return pad ? capacity_ - off : kHeader + size_t{len};
+  }
+
+  bool fits(uint64_t head, size_t need) noexcept {
+    if (head + need - tail_cache_ <= capacity_) {
+      return true;
+    }
+    tail_cache_ = tail_.load(std::memory_order_acquire);
+    return head + need - tail_cache_ <= capacity_;
+  }
+
+  std::unique_ptr<std::byte[]> data_;
+  size_t capacity_{0};
+  std::atomic<bool> ready_{false};
+
+  // Producer side.
+  alignas(64) std::atomic<uint64_t> head_{0};
+  uint64_t tail_cache_{0};
+  uint64_t reserved_{0};
+
+  // Consumer side.
+  alignas(64) std::atomic<uint64_t> tail_{0};
+  uint64_t read_{0};
+  uint64_t head_cache_{0};
+};
+
+}  // namespace bits
@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <bits/aggregator.hpp>
+#include <bits/thread_slots.hpp>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace bits;
+
+TEST(ThreadSlotsTest, OneSlotPerThread) {
+  ThreadSlots<int> slots;
+
+  slots.local() = 1;
+  EXPECT_EQ(&slots.local(), &slots.local());
+
+  std::thread([&] { slots.local() = 2; }).join();
+
+  int sum      = 0;
+  int orphaned = 0;
+  slots.forEach([&](int& v, bool dead) {
+    sum += v;
+    orphaned += dead ? 1 : 0;
+  });
+  EXPECT_EQ(sum, 3);
+  EXPECT_EQ(orphaned, 1);
+
+  // Exited thread is dropped after being visited once.
+  EXPECT_EQ(slots.size(), 1);
+}
+
+namespace {
+struct Tracked {
+  Tracked() { live++; }
+  ~Tracked() { live--; }
+  static inline std::atomic<int> live{0};
+};
+}  // namespace
+
+TEST(ThreadSlotsTest, DestroyedObjectFreesSlots) {
+  // The thread outlives every object; their slots must not.
+  std::thread([] {
+    for (int i = 0; i < 1000; i++) {
+      auto slots = std::make_unique<ThreadSlots<Tracked>>();
+      slots->local();
+      EXPECT_EQ(Tracked::live.load(), 1);
+      slots.reset();
+      EXPECT_EQ(Tracked::live.load(), 0);
+    }
+  }).join();
+
+  // Reused indices do not hand out another object's slot.
+  ThreadSlots<int> a;
+  a.local() = 1;
+  {
+    auto b = std::make_unique<ThreadSlots<int>>();
+    b->local() = 2;
+  }
+  ThreadSlots<int> c;
+  EXPECT_EQ(c.local(), 0);
+  EXPECT_EQ(a.local(), 1);
+}
+
+TEST(AggregatorTest, SummaryPerAcquire) {
+  Aggregator agg;
+  EXPECT_TRUE(agg.acquire().empty());
+
+  agg.add(1.0);
+  agg.add(5.0);
+  agg.add(3.0);
+
+  auto s = agg.acquire();
+  EXPECT_EQ(s.count, 3);
+  EXPECT_DOUBLE_EQ(s.sum, 9.0);
+  EXPECT_DOUBLE_EQ(s.min, 1.0);
+  EXPECT_DOUBLE_EQ(s.max, 5.0);
+
+  EXPECT_TRUE(agg.acquire().empty());
+
+  agg.add(10.0);
+  s = agg.acquire();
+  EXPECT_EQ(s.count, 1);
+  EXPECT_DOUBLE_EQ(s.min, 10.0);
+  EXPECT_DOUBLE_EQ(s.max, 10.0);
+}
+
+TEST(AggregatorTest, InfDoesNotPoisonLaterWindows) {
+  Aggregator agg;
+  agg.add(std::numeric_limits<double>::infinity());
+  agg.add(1.0);
+  EXPECT_EQ(agg.acquire().sum, std::numeric_limits<double>::infinity());
+
+  agg.add(2.0);
+  agg.add(3.0);
+  auto s = agg.acquire();
+  EXPECT_EQ(s.count, 2);
+  EXPECT_DOUBLE_EQ(s.sum, 5.0);
+
+  // The window that held +inf starts over.
+  agg.add(-std::numeric_limits<double>::infinity());
+  EXPECT_EQ(agg.acquire().sum, -std::numeric_limits<double>::infinity());
+  agg.add(4.0);
+  EXPECT_DOUBLE_EQ(agg.acquire().sum, 4.0);
+  agg.add(5.0);
+  EXPECT_DOUBLE_EQ(agg.acquire().sum, 5.0);
+}
+
+TEST(AggregatorTest, ConcurrentWritersLoseNothing) {
+  Aggregator agg;
+  std::atomic<bool> stop{false};
+
+  uint64_t count = 0;
+  double sum     = 0;
+  std::thread consumer([&] {
+    while (!stop.load()) {
+      auto s = agg.acquire();
+      count += s.count;
+      sum += s.sum;
+    }
+  });
+
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; t++) {
+    writers.emplace_back([&] {
+      for (int i = 0; i < 100000; i++) {
+        agg.add(1.0);
+      }
+    });
+  }
+  for (auto& w : writers) {
+    w.join();
+  }
+
+  stop = true;
+  consumer.join();
+
+  auto s = agg.acquire();
+  count += s.count;
+  sum += s.sum;
+
+  EXPECT_EQ(count, 400000);
+  EXPECT_DOUBLE_EQ(sum, 400000.0);
+}
@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <bits/buffer.hpp>
+#include <bits/cpu.hpp>
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace bits;
+
+TEST(MPSCBufferTest, ShardsAllocatedOnFirstAppend) {
+  MPSCBuffer<double> buffer;
+  EXPECT_EQ(buffer.shards(), 0);
+  EXPECT_TRUE(buffer.acquire().empty());
+
+  buffer.append(1.0);
+  EXPECT_EQ(buffer.shards(), 1);
+
+  std::thread([&] { buffer.append(2.0); }).join();
+  EXPECT_EQ(buffer.shards(), 2);
+
+  auto data = buffer.acquire();
+  std::vector<double> values(data.begin(), data.end());
+  std::ranges::sort(values);
+  EXPECT_EQ(values, (std::vector<double>{1.0, 2.0}));
+}
+
+TEST(MPSCBufferTest, ConfigurableSlots) {
+  MPSCBuffer<int> buffer({.slots = 5});
+  EXPECT_EQ(buffer.slots(), 8);
+
+  for (int i = 0; i < 20; i++) {
+    buffer.append(i);
+  }
+
+  // Full shards keep the oldest values and count the rest as dropped.
+  auto data = buffer.acquire();
+  EXPECT_EQ(std::vector<int>(data.begin(), data.end()),
+            (std::vector<int>{0, 1, 2, 3, 4, 5, 6, 7}));
+  EXPECT_EQ(buffer.dropped(), 12);
+
+  EXPECT_TRUE(buffer.acquire().empty());
+  EXPECT_EQ(buffer.dropped(), 0);
+}
+
+TEST(MPSCBufferTest, OverflowSegment) {
+  MPSCBuffer<int> buffer({.slots = 4, .overflow = 10});
+
+  for (int i = 0; i < 20; i++) {
+    buffer.append(i);
+  }
+
+  auto data = buffer.acquire();
+  std::vector<int> expected(14);
+  std::iota(expected.begin(), expected.end(), 0);
+  EXPECT_EQ(std::vector<int>(data.begin(), data.end()), expected);
+  EXPECT_EQ(buffer.dropped(), 6);
+}
+
+TEST(MPSCBufferTest, PressureSignalledOncePerWindow) {
+  MPSCBuffer<int> buffer({.slots = 8});
+  int signalled = 0;
+  buffer.onPressure([&] { signalled++; });
+
+  for (int i = 0; i < 5; i++) {
+    buffer.append(i);
+  }
+  EXPECT_EQ(signalled, 0);
+
+  for (int i = 0; i < 20; i++) {
+    buffer.append(i);
+  }
+  EXPECT_EQ(signalled, 1);
+
+  buffer.acquire();
+  for (int i = 0; i < 7; i++) {
+    buffer.append(i);
+  }
+  EXPECT_EQ(signalled, 2);
+}
+
+TEST(MPSCBufferTest, IdleShardsReleased) {
+  MPSCBuffer<int> buffer({.idle_flips = 3});
+
+  buffer.append(1);
+  EXPECT_EQ(buffer.acquire().size(), 1);
+  EXPECT_EQ(buffer.shards(), 1);
+
+  for (int i = 0; i < 3; i++) {
+    EXPECT_TRUE(buffer.acquire().empty());
+  }
+  EXPECT_EQ(buffer.shards(), 0);
+
+  buffer.append(2);
+  EXPECT_EQ(buffer.shards(), 1);
+  auto data = buffer.acquire();
+  ASSERT_EQ(data.size(), 1);
+  EXPECT_EQ(data[0], 2);
+}
+
+TEST(MPSCBufferTest, ShardsReleasedUnderConcurrentAppends) {
+  // Shards are released after a single empty acquire while writers come
+  // and go, so writers keep racing with release; nothing may be lost.
+  MPSCBuffer<int> buffer({.slots = 1 << 16, .idle_flips = 1});
+  std::atomic<bool> done{false};
+  size_t seen = 0;
+  std::thread consumer([&] {
+    while (!done.load()) {
+      seen += buffer.acquire().size();
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 2000; i++) {
+        buffer.append(i);
+        if (i % 100 == 0) {
+          std::this_thread::sleep_for(std::chrono::microseconds(50));
+        }
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  done = true;
+  consumer.join();
+  for (int i = 0; i < 3; i++) {
+    seen += buffer.acquire().size();
+  }
+
+  EXPECT_EQ(seen, 8000U);
+  EXPECT_EQ(buffer.shards(), 0U);
+}
+
+TEST(MPSCBufferTest, ConcurrentAppend) {
+  MPSCBuffer<int> buffer;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 500; i++) {
+        buffer.append(i);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_EQ(buffer.acquire().size(), 2000);
+}
+
+TEST(MPSCBufferTest, CpuSharding) {
+  MPSCBuffer<int> buffer({.policy = ShardPolicy::Cpu});
+  EXPECT_EQ(buffer.capacity(), std::bit_ceil(onlineCpus()));
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; i++) {
+        buffer.append(i);
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  EXPECT_LE(buffer.shards(), buffer.capacity());
+  EXPECT_EQ(buffer.acquire().size(), 800);
+}
+
+TEST(CpuTest, CurrentCpuWithinConfiguredRange) {
+  EXPECT_GE(onlineCpus(), 1);
+  EXPECT_LT(currentCpu(), static_cast<size_t>(::sysconf(_SC_NPROCESSORS_CONF)));
+  EXPECT_EQ(threadIndex(), threadIndex());
+}
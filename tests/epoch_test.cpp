@@ -0,0 +1,79 @@
+#include <gtest/gtest.h>
+#include <bits/epoch.hpp>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace bits;
+
+namespace {
+struct Version {
+  explicit Version(int v) : value(v) {}
+  ~Version() { value = -1; }
+  int value;
+};
+}  // namespace
+
+TEST(EpochDomainTest, ReclaimWaitsForPinnedReaders) {
+  EpochDomain domain;
+  std::atomic<const Version*> current{new Version(1)};
+
+  const auto* old = current.load();
+  auto guard      = std::make_unique<EpochDomain::Guard>(domain.pin());
+  EXPECT_EQ(current.load()->value, 1);
+
+  // Reclaim from another thread while this one is still pinned.
+  std::thread([&] {
+    current.store(new Version(2));
+    domain.retire(old);
+    EXPECT_EQ(domain.reclaim(), 1U);
+  }).join();
+  EXPECT_EQ(old->value, 1);
+
+  guard.reset();
+  EXPECT_EQ(domain.reclaim(), 0U);
+  delete current.load();
+}
+
+TEST(EpochDomainTest, NestedPinsKeepOuterEpoch) {
+  EpochDomain domain;
+  const auto outer = domain.pin();
+  domain.retire(new Version(1));
+  {
+    const auto inner = domain.pin();
+  }
+  EXPECT_EQ(domain.reclaim(), 1U);
+}
+
+TEST(EpochDomainTest, ConcurrentReadersNeverSeeFreed) {
+  EpochDomain domain;
+  std::atomic<const Version*> current{new Version(0)};
+  std::atomic<bool> stop{false};
+  std::atomic<int> bad{0};
+
+  std::vector<std::jthread> readers;
+  for (int t = 0; t < 4; t++) {
+    readers.emplace_back([&] {
+      while (!stop.load(std::memory_order_relaxed)) {
+        const auto guard = domain.pin();
+        const auto* v    = current.load();
+        if (v->value < 0) {
+          bad.fetch_add(1);
+        }
+      }
+    });
+  }
+
+  for (int i = 1; i <= 20000; i++) {
+    const auto* old = current.load();
+    current.store(new Version(i));
+    domain.retire(old);
+    domain.reclaim();
+  }
+  stop = true;
+  readers.clear();
+
+  EXPECT_EQ(bad.load(), 0);
+  EXPECT_EQ(domain.reclaim(), 0U);
+  delete current.load();
+}
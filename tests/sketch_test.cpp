@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <bits/sketch.hpp>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <vector>
+
+using namespace bits;
+
+TEST(DDSketchTest, EmptySketch) {
+  DDSketch<> sketch;
+
+  EXPECT_TRUE(sketch.empty());
+  EXPECT_EQ(sketch.count(), 0);
+  EXPECT_TRUE(std::isnan(sketch.quantile(0.5)));
+}
+
+TEST(DDSketchTest, IgnoresNonFiniteValues) {
+  DDSketch<> sketch;
+  sketch.add(std::numeric_limits<double>::infinity());
+  sketch.add(-std::numeric_limits<double>::infinity());
+  sketch.add(std::nan(""));
+  EXPECT_TRUE(sketch.empty());
+
+  sketch.add(2.0);
+  EXPECT_EQ(sketch.count(), 1);
+  EXPECT_DOUBLE_EQ(sketch.max(), 2.0);
+  EXPECT_NEAR(sketch.quantile(1.0), 2.0, 2.0 * 0.02);
+}
+
+TEST(DDSketchTest, RelativeErrorBound) {
+  DDSketch<> sketch;
+
+  std::vector<double> data;
+  for (int i = 1; i <= 100000; i++) {
+    data.push_back(static_cast<double>(i));
+    sketch.add(static_cast<double>(i));
+  }
+
+  EXPECT_EQ(sketch.count(), 100000);
+  EXPECT_DOUBLE_EQ(sketch.min(), 1.0);
+  EXPECT_DOUBLE_EQ(sketch.max(), 100000.0);
+  EXPECT_DOUBLE_EQ(sketch.sum(), 100000.0 * 100001.0 / 2);
+
+  for (double q : {0.0, 0.1, 0.5, 0.9, 0.99, 0.999, 1.0}) {
+    const double expected =
+        data[static_cast<size_t>(q * static_cast<double>(data.size() - 1))];
+    EXPECT_NEAR(sketch.quantile(q), expected, expected * 0.02) << "q=" << q;
+  }
+}
+
+TEST(DDSketchTest, NegativeAndZeroValues) {
+  DDSketch<> sketch;
+
+  for (int i = -50; i <= 50; i++) {
+    sketch.add(static_cast<double>(i));
+  }
+
+  EXPECT_NEAR(sketch.quantile(0.0), -50.0, 1.0);
+  EXPECT_DOUBLE_EQ(sketch.quantile(0.5), 0.0);
+  EXPECT_NEAR(sketch.quantile(1.0), 50.0, 1.0);
+  EXPECT_NEAR(sketch.quantile(0.25), -25.0, 0.5);
+}
+
+TEST(DDSketchTest, MergeMatchesSingleSketch) {
+  DDSketch<> a;
+  DDSketch<> b;
+  DDSketch<> all;
+
+  for (int i = 1; i <= 1000; i++) {
+    (i % 2 == 0 ? a : b).add(static_cast<double>(i));
+    all.add(static_cast<double>(i));
+  }
+
+  a.merge(b);
+
+  EXPECT_EQ(a.count(), all.count());
+  EXPECT_DOUBLE_EQ(a.sum(), all.sum());
+  for (double q : {0.1, 0.5, 0.99}) {
+    EXPECT_DOUBLE_EQ(a.quantile(q), all.quantile(q));
+  }
+}
+
+TEST(DDSketchTest, CollapsesLowestBuckets) {
+  DDSketch<64, 0.02> sketch;
+
+  for (int i = 0; i < 1000; i++) {
+    sketch.add(1e-3);
+  }
+  sketch.add(1e9);
+
+  // High quantiles stay accurate, low ones collapse upwards.
+  EXPECT_NEAR(sketch.quantile(1.0), 1e9, 1e9 * 0.02);
+  EXPECT_GE(sketch.quantile(0.5), 1e-3);
+  EXPECT_EQ(sketch.count(), 1001);
+}
+
+TEST(DDSketchTest, ClearResets) {
+  DDSketch<> sketch;
+  sketch.add(10.0);
+  sketch.clear();
+
+  EXPECT_TRUE(sketch.empty());
+  sketch.add(20.0);
+  EXPECT_NEAR(sketch.quantile(0.5), 20.0, 0.4);
+}
+
+TEST(MPSCSketchTest, ConcurrentAppend) {
+  MPSCSketch<> sketch;
+
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; t++) {
+    threads.emplace_back([&] {
+      for (int i = 1; i <= 1000; i++) {
+        sketch.append(static_cast<double>(i));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+
+  const auto& merged = sketch.acquire();
+  EXPECT_EQ(merged.count(), 4000);
+  EXPECT_NEAR(merged.quantile(0.5), 500.0, 10.0);
+
+  EXPECT_TRUE(sketch.acquire().empty());
+}
@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+#include <bits/timer_wheel.hpp>
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+using namespace bits;
+
+TEST(TimerWheelTest, FiresAtDueTick) {
+  TimerWheel<int> wheel;
+  wheel.schedule(1, 5);
+  wheel.schedule(2, 70);
+  wheel.schedule(3, 5000);
+  EXPECT_EQ(wheel.size(), 3U);
+  EXPECT_EQ(wheel.next(), 5U);
+
+  std::vector<int> out;
+  wheel.advance(4, out);
+  EXPECT_TRUE(out.empty());
+  wheel.advance(5, out);
+  EXPECT_EQ(out, (std::vector<int>{1}));
+
+  out.clear();
+  wheel.advance(69, out);
+  EXPECT_TRUE(out.empty());
+  wheel.advance(4999, out);
+  EXPECT_EQ(out, (std::vector<int>{2}));
+
+  out.clear();
+  wheel.advance(5000, out);
+  EXPECT_EQ(out, (std::vector<int>{3}));
+  EXPECT_TRUE(wheel.empty());
+  EXPECT_EQ(wheel.next(), UINT64_MAX);
+}
+
+TEST(TimerWheelTest, PastDueFiresNext) {
+  TimerWheel<int> wheel(100);
+  wheel.schedule(1, 10);
+  std::vector<int> out;
+  wheel.advance(100, out);
+  EXPECT_EQ(out, (std::vector<int>{1}));
+}
+
+TEST(TimerWheelTest, BeyondRangeIsRefiled) {
+  TimerWheel<int> wheel;
+  const uint64_t far = (uint64_t{1} << 24) * 3 + 12345;
+  wheel.schedule(1, far);
+
+  std::vector<int> out;
+  wheel.advance(far - 1, out);
+  EXPECT_TRUE(out.empty());
+  wheel.advance(far, out);
+  EXPECT_EQ(out, (std::vector<int>{1}));
+}
+
+TEST(TimerWheelTest, MatchesSortedOrder) {
+  std::mt19937_64 rng(42);
+  TimerWheel<uint64_t> wheel(1000);
+  std::vector<std::pair<uint64_t, uint64_t>> expected;
+
+  // Periodic rescheduling, the way the runtime uses it.
+  std::vector<uint64_t> period(200);
+  for (uint64_t id = 0; id < period.size(); ++id) {
+    period[id] = 1 + rng() % 7000;
+    wheel.schedule(id, 1000 + period[id]);
+  }
+
+  std::vector<uint64_t> out;
+  std::vector<uint64_t> due(period.size());
+  for (uint64_t id = 0; id < period.size(); ++id) {
+    due[id] = 1000 + period[id];
+  }
+
+  uint64_t now = 1000;
+  while (now < 200000) {
+    now += 1 + rng() % 300;
+    out.clear();
+    wheel.advance(now, out);
+    uint64_t last = 0;
+    for (const auto id : out) {
+      // Fired no later than asked and never early.
+      EXPECT_LE(due[id], now);
+      EXPECT_GT(due[id], now - 301);
+      EXPECT_GE(due[id], last);
+      last    = due[id];
+      due[id] = now + period[id];
+      wheel.schedule(id, due[id]);
+    }
+    for (uint64_t id = 0; id < due.size(); ++id) {
+      EXPECT_GT(due[id], now);
+    }
+  }
+  EXPECT_EQ(wheel.size(), period.size());
+}
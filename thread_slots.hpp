@@ -0,0 +1,120 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bits {
+
+// One `Slot` per (ThreadSlots object, thread) pair, shared between the
+// owning thread and the object. After the first call, local() is a
+// thread_local array lookup with no atomics; forEach() visits every slot
+// from the consumer side. Slots of exited threads are visited once more
+// and then dropped. Slots of a destroyed object are freed with it, and its
+// index into the per-thread caches is handed to the next object created.
+template <typename Slot>
+class ThreadSlots {
+ public:
+  ThreadSlots()
+      : id_(acquireId()), key_(keys_.fetch_add(1, std::memory_order_relaxed)) {}
+
+  ~ThreadSlots() {
+    std::unique_lock lock(ids_mutex_);
+    free_ids_.push_back(id_);
+  }
+
+  ThreadSlots(const ThreadSlots&)            = delete;
+  ThreadSlots& operator=(const ThreadSlots&) = delete;
+
+  Slot& local() {
+    auto& cache = cache_;
+    if (id_ < cache.refs.size() && cache.refs[id_].key == key_) [[likely]] {
+      return *cache.refs[id_].slot;
+    }
+    return attach(cache);
+  }
+
+  // fn(Slot&, bool orphaned)
+  template <typename Fn>
+  void forEach(Fn&& fn) {
+    std::unique_lock lock(mutex_);
+    std::erase_if(entries_, [&](const std::shared_ptr<Entry>& entry) {
+      const bool orphaned = entry->orphaned.load(std::memory_order_acquire);
+      fn(entry->slot, orphaned);
+      return orphaned;
+    });
+  }
+
+  [[nodiscard]] size_t size() {
+    std::unique_lock lock(mutex_);
+    return entries_.size();
+  }
+
+ private:
+  struct Entry {
+    Slot slot;
+    std::atomic<bool> orphaned{false};
+  };
+
+  // `key` tells the current owner of an index apart from earlier ones
+  // whose slot may already be freed.
+  struct Ref {
+    Slot* slot   = nullptr;
+    uint64_t key = 0;
+    std::weak_ptr<Entry> entry;
+  };
+
+  struct Cache {
+    ~Cache() {
+      for (auto& ref : refs) {
+        if (auto entry = ref.entry.lock()) {
+          entry->orphaned.store(true, std::memory_order_release);
+        }
+      }
+    }
+
+    std::vector<Ref> refs;
+  };
+
+  static size_t acquireId() {
+    std::unique_lock lock(ids_mutex_);
+    if (free_ids_.empty()) {
+      return next_id_++;
+    }
+    const size_t id = free_ids_.back();
+    free_ids_.pop_back();
+    return id;
+  }
+
+  Slot& attach(Cache& cache) {
+    // Not make_shared: the weak references in other threads' caches
+    // would keep the slot's memory allocated until those threads exit.
+    std::shared_ptr<Entry> entry(new Entry());
+    if (cache.refs.size() <= id_) {
+      cache.refs.resize(id_ + 1);
+    }
+    {
+      std::unique_lock lock(mutex_);
+      entries_.push_back(entry);
+    }
+    cache.refs[id_] = {.slot = &entry->slot, .key = key_, .entry = entry};
+    return entry->slot;
+  }
+
+  static inline std::mutex ids_mutex_;
+  static inline size_t next_id_{0};
+  static inline std::vector<size_t> free_ids_;
+  // Never reused, unlike ids.
+  static inline std::atomic<uint64_t> keys_{1};
+  static inline thread_local Cache cache_;
+
+  const size_t id_;
+  const uint64_t key_;
+  std::mutex mutex_;
+  std::vector<std::shared_ptr<Entry>> entries_;
+};
+
+}  // namespace bits
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+
+namespace bits {
+
+// Hierarchical timer wheel over integer ticks: 4 levels of 64 slots, so
+// level l holds timers due within 64^(l+1) ticks and covers 2^24 ticks
+// in all (later ones are parked in the top level and re-filed when it
+// turns). Timers cascade down a level when their block comes up and fire
+// from level 0. advance() jumps straight to the next occupied slot or
+// cascade using per-level occupancy masks, so its cost follows the timers
+// fired and cascaded rather than the ticks elapsed.
+template <typename T>
+class TimerWheel {
+ public:
+  explicit TimerWheel(uint64_t now = 0) : now_(now) {}
+
+  [[nodiscard]] bool empty() const noexcept { return size_ == 0; }
+  [[nodiscard]] size_t size() const noexcept { return size_; }
+  // Next tick advance() will process.
+  [[nodiscard]] uint64_t now() const noexcept { return now_; }
+
+  // Due ticks in the past fire on the next advance().
+  void schedule(T value, uint64_t due) {
+    insert({std::move(value), std::max(due, now_)});
+    size_++;
+  }
+
+  // Fires everything due at or before `to`, appending to `out` in due
+  // order.
+  void advance(uint64_t to, std::vector<T>& out) {
+    while (now_ <= to) {
+      const uint64_t at = next();
+      if (at > now_) {
+        now_ = at > to ? to + 1 : at;
+        continue;
+      }
+
+      for (int l = kLevels - 1; l > 0; --l) {
+        if ((now_ & (span(l) - 1)) == 0) {
+          cascade(l);
+        }
+      }
+
+      auto& slot = slots_[0][now_ & kMask];
+      for (auto& entry : slot) {
+        out.push_back(std::move(entry.value));
+      }
+      size_ -= slot.size();
+      slot.clear();
+      occupied_[0] &= ~(uint64_t{1} << (now_ & kMask));
+      now_++;
+    }
+  }
+
+  // Earliest tick advance() has work at: a level 0 slot to fire or an
+  // occupied higher slot to cascade. A lower bound for the next timer;
+  // max() when empty.
+  [[nodiscard]] uint64_t next() const noexcept {
+    uint64_t at = std::numeric_limits<uint64_t>::max();
+    for (int l = 0; l < kLevels; ++l) {
+      if (occupied_[l] == 0) {
+        continue;
+      }
+      // First block at this level not yet processed.
+      const int shift      = kBits * l;
+      const uint64_t block = (now_ + span(l) - 1) >> shift;
+      const auto skip      = static_cast<uint64_t>(std::countr_zero(
+          std::rotr(occupied_[l], static_cast<int>(block & kMask))));
+      at = std::min(at, (block + skip) << shift);
+    }
+    return at;
+  }
+
+ private:
+  static constexpr int kLevels    = 4;
+  static constexpr int kBits      = 6;
+  static constexpr uint64_t kMask = (uint64_t{1} << kBits) - 1;
+
+  struct Entry {
+    T value;
+    uint64_t due;
+  };
+
+  void insert(Entry entry) {
+    const uint64_t delta = entry.due - now_;
+    int level            = 0;
+    while (level < kLevels - 1 && delta >= span(level + 1)) {
+      level++;
+    }
+
+    uint64_t slot = (entry.due >> (kBits * level)) & kMask;
+    if (delta >= span(kLevels)) {
+      // Beyond the top level: park in the slot turning last.
+      slot = ((now_ >> (kBits * level)) - 1) & kMask;
+    }
+    slots_[level][slot].push_back(std::move(entry));
+    occupied_[level] |= uint64_t{1} << slot;
+  }
+
+  void cascade(int level) {
+    const uint64_t slot = (now_ >> (kBits * level)) & kMask;
+    auto entries        = std::exchange(slots_[level][slot], {});
+    occupied_[level] &= ~(uint64_t{1} << slot);
+    for (auto& entry : entries) {
+      insert(std::move(entry));
+    }
+    // Hand the storage back so the slot does not reallocate next turn.
+    entries.clear();
+    slots_[level][slot] = std::move(entries);
+  }
+
+  static constexpr uint64_t span(int level) noexcept {
+    return uint64_t{1} << (kBits * level);
+  }
+
+  std::array<std::array<std::vector<Entry>, 64>, kLevels> slots_{};
+  std::array<uint64_t, kLevels> occupied_{};
+  uint64_t now_;
+  size_t size_{0};
+};
+
+}  // namespace bits
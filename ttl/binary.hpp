@@ -0,0 +1,146 @@
+#pragma once
+
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+// Binary segment format.
+//
+//   segment := header block*
+//   header  := "TTLB" u8:version u8[3]:reserved
+//   block   := u32:size u32:crc32c(payload) payload[size]
+//   payload := (symbol | record)*
+//   symbol  := 0x01 varint:id varint:len bytes[len]
+//   record  := 0x02 varint:type varint:name zigzag:ts-delta varint:n field[n]
+//   field   := varint:key u8:kind value
+//
+// Integers are little-endian. Symbol ids are local to the segment, and
+// every block defines the ids it uses before their first use in it.
+// Timestamp deltas and XOR'd doubles restart at every block too, so a
+// block decodes on its own and a corrupt block loses only its records.
+// A file may hold several segments back to back; a new header resets
+// the dictionary.
+namespace bits::ttl::binary {
+
+constexpr std::string_view kMagic = "TTLB";
+constexpr uint8_t kVersion        = 1;
+constexpr size_t kHeaderSize      = 8;
+constexpr size_t kBlockHeaderSize = 8;
+
+enum class Tag : uint8_t {
+  Symbol = 1,
+  Record = 2,
+};
+
+enum class WireKind : uint8_t {
+  Int    = 0,
+  Double = 1,
+  String = 2,
+  // XOR with the previous double of the same key in the block:
+  // u8 (leading zero bytes << 4 | trailing zero bytes), then the
+  // remaining middle bytes.
+  DoubleXor = 3,
+};
+
+inline void putVarint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+constexpr uint64_t zigzag(int64_t v) noexcept {
+  return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+constexpr int64_t unzigzag(uint64_t v) noexcept {
+  return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+inline void putXor(std::string& out, uint64_t x) {
+  if (x == 0) {
+    out.push_back(static_cast<char>(8 << 4));
+    return;
+  }
+  const int lead  = std::countl_zero(x) / 8;
+  const int trail = std::countr_zero(x) / 8;
+  out.push_back(static_cast<char>(lead << 4 | trail));
+  x >>= trail * 8;
+  for (int i = 0; i < 8 - lead - trail; ++i) {
+    out.push_back(static_cast<char>(x & 0xFF));
+    x >>= 8;
+  }
+}
+
+// Bounds-checked cursor over an encoded payload. Reads past the end
+// set `ok` to false and return zeros.
+struct Cursor {
+  const uint8_t* p;
+  const uint8_t* end;
+  bool ok = true;
+
+  [[nodiscard]] bool done() const noexcept { return p >= end; }
+
+  uint8_t byte() noexcept {
+    if (p >= end) {
+      ok = false;
+      return 0;
+    }
+    return *p++;
+  }
+
+  uint64_t varint() noexcept {
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+      const uint8_t b = byte();
+      v |= static_cast<uint64_t>(b & 0x7F) << shift;
+      if ((b & 0x80) == 0) {
+        return v;
+      }
+    }
+    ok = false;
+    return v;
+  }
+
+  std::string_view bytes(size_t n) noexcept {
+    if (static_cast<size_t>(end - p) < n) {
+      ok = false;
+      p  = end;
+      return {};
+    }
+    const auto* s = reinterpret_cast<const char*>(p);
+    p += n;
+    return {s, n};
+  }
+
+  uint64_t fixed(size_t n) noexcept {
+    uint64_t v  = 0;
+    const auto b = bytes(n);
+    for (size_t i = 0; i < b.size(); ++i) {
+      v |= static_cast<uint64_t>(static_cast<uint8_t>(b[i])) << (8 * i);
+    }
+    return v;
+  }
+
+  uint64_t xorDelta() noexcept {
+    const uint8_t h   = byte();
+    const int lead    = h >> 4;
+    const int trail   = h & 0x0F;
+    const int middle  = 8 - lead - trail;
+    if (middle < 0) {
+      ok = false;
+      return 0;
+    }
+    return middle == 0 ? 0 : fixed(static_cast<size_t>(middle)) << (trail * 8);
+  }
+};
+
+}  // namespace bits::ttl::binary
@@ -0,0 +1,204 @@
+#include "binary_reader.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <string>
+#include <system_error>
+#include "binary.hpp"
+#include "hash.hpp"
+#include "throw_if_not.hpp"
+
+namespace bits::ttl {
+
+namespace {
+uint32_t getFixed32(const uint8_t* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+         static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+
+// Tag, id and length of the shortest symbol definition.
+constexpr size_t kMinSymbolBytes = 3;
+
+bool isHeader(const uint8_t* p, size_t left) {
+  return left >= binary::kHeaderSize &&
+         std::memcmp(p, binary::kMagic.data(), binary::kMagic.size()) == 0;
+}
+}  // namespace
+
+SegmentReader::SegmentReader(std::string_view path) {
+  const int fd = ::open(std::string(path).c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::format("ttl: failed to open {}", path));
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) != 0) {
+    const int err = errno;
+    ::close(fd);
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: failed to stat {}", path));
+  }
+
+  size_ = static_cast<size_t>(st.st_size);
+  if (size_ != 0) {
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      const int err = errno;
+      ::close(fd);
+      throw std::system_error(err, std::generic_category(),
+                              std::format("ttl: failed to map {}", path));
+    }
+    data_ = static_cast<const uint8_t*>(p);
+    ::madvise(p, size_, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+
+  if (!isHeader(data_, size_) || data_[4] != binary::kVersion) {
+    if (data_ != nullptr) {
+      ::munmap(const_cast<uint8_t*>(data_), size_);
+    }
+    throw std::runtime_error(
+        std::format("ttl: {} is not a binary segment", path));
+  }
+}
+
+SegmentReader::~SegmentReader() {
+  if (data_ != nullptr) {
+    ::munmap(const_cast<uint8_t*>(data_), size_);
+  }
+}
+
+bool SegmentReader::nextBlock() {
+  while (true) {
+    const size_t left = size_ - pos_;
+    if (isHeader(data_ + pos_, left)) {
+      dict_.clear();
+      pos_ += binary::kHeaderSize;
+      continue;
+    }
+    if (left < binary::kBlockHeaderSize) {
+      return false;
+    }
+
+    const uint32_t len = getFixed32(data_ + pos_);
+    const uint32_t crc = getFixed32(data_ + pos_ + 4);
+    if (len > left - binary::kBlockHeaderSize) {
+      return false;
+    }
+
+    const auto* payload = data_ + pos_ + binary::kBlockHeaderSize;
+    pos_ += binary::kBlockHeaderSize + len;
+    if (bits::crc32c(std::as_bytes(std::span(payload, len))) != crc) {
+      corrupt_++;
+      continue;
+    }
+
+    block_     = payload;
+    block_end_ = payload + len;
+    last_ts_   = 0;
+    std::ranges::fill(last_double_, 0);
+    return true;
+  }
+}
+
+std::string_view SegmentReader::symbol(uint64_t id) const noexcept {
+  return id < dict_.size() ? dict_[id] : std::string_view{};
+}
+
+std::optional<RecordView> SegmentReader::next() {
+  while (true) {
+    if (block_ == block_end_ && !nextBlock()) {
+      return std::nullopt;
+    }
+
+    binary::Cursor c{block_, block_end_};
+    while (!c.done()) {
+      const auto tag = static_cast<binary::Tag>(c.byte());
+      if (tag == binary::Tag::Symbol) {
+        const uint64_t id  = c.varint();
+        const auto str     = c.bytes(c.varint());
+        // Ids are dense and every definition takes at least three bytes,
+        // so a larger id is corrupt rather than a reason to allocate.
+        if (!c.ok || id >= size_ / kMinSymbolBytes) {
+          c.ok = false;
+          break;
+        }
+        if (id >= dict_.size()) {
+          dict_.resize(id + 1);
+        }
+        dict_[id] = str;
+        continue;
+      }
+      if (tag != binary::Tag::Record) {
+        c.ok = false;
+        break;
+      }
+
+      RecordView r;
+      r.type = symbol(c.varint());
+      r.name = symbol(c.varint());
+      last_ts_ += binary::unzigzag(c.varint());
+      r.timestamp = std::chrono::nanoseconds(last_ts_);
+
+      const uint64_t n = c.varint();
+      fields_.clear();
+      for (uint64_t k = 0; k < n && c.ok; ++k) {
+        const uint64_t key = c.varint();
+        FieldView f{
+            .key = symbol(key), .kind = Kind::Int, .i = 0, .d = 0, .s = {}};
+        switch (static_cast<binary::WireKind>(c.byte())) {
+          case binary::WireKind::Int:
+            f.i = binary::unzigzag(c.varint());
+            break;
+          case binary::WireKind::Double:
+            f.kind = Kind::Double;
+            f.d    = std::bit_cast<double>(c.fixed(8));
+            break;
+          case binary::WireKind::DoubleXor: {
+            // Keys are defined earlier in the block.
+            if (key >= dict_.size()) {
+              c.ok = false;
+              break;
+            }
+            if (key >= last_double_.size()) {
+              last_double_.resize(dict_.size(), 0);
+            }
+            f.kind            = Kind::Double;
+            last_double_[key] ^= c.xorDelta();
+            f.d               = std::bit_cast<double>(last_double_[key]);
+            break;
+          }
+          case binary::WireKind::String:
+            f.kind = Kind::String;
+            f.s    = c.bytes(c.varint());
+            break;
+          default:
+            c.ok = false;
+            break;
+        }
+        fields_.push_back(f);
+      }
+      if (!c.ok) {
+        break;
+      }
+
+      block_  = c.p;
+      r.fields = fields_;
+      return r;
+    }
+
+    if (!c.ok) {
+      corrupt_++;
+    }
+    block_ = block_end_;
+  }
+}
+
+}  // namespace bits::ttl
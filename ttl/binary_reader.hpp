@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+#include <vector>
+#include "types.hpp"
+
+namespace bits::ttl {
+
+struct FieldView {
+  std::string_view key;
+  Kind kind;
+  int64_t i      = 0;
+  double d       = 0;
+  std::string_view s;
+};
+
+// Strings point into the mapped file; `fields` is only valid until the
+// next call to SegmentReader::next().
+struct RecordView {
+  std::string_view type;
+  std::string_view name;
+  std::chrono::nanoseconds timestamp;
+  std::span<const FieldView> fields;
+};
+
+// Streams records out of a binary segment file (see binary.hpp) without
+// copying: the file is mmap'ed and all strings are views into it.
+// Blocks failing their checksum are skipped and counted; a truncated
+// last block (e.g. a writer killed mid-write) ends the stream.
+class SegmentReader {
+ public:
+  // Throws std::system_error if the file cannot be mapped and
+  // std::runtime_error if it does not start with a segment header.
+  explicit SegmentReader(std::string_view path);
+  ~SegmentReader();
+
+  SegmentReader(const SegmentReader&)            = delete;
+  SegmentReader& operator=(const SegmentReader&) = delete;
+
+  std::optional<RecordView> next();
+
+  // Blocks skipped because of a checksum or decoding error.
+  [[nodiscard]] size_t corrupt() const noexcept { return corrupt_; }
+
+ private:
+  bool nextBlock();
+  std::string_view symbol(uint64_t id) const noexcept;
+
+  const uint8_t* data_{nullptr};
+  size_t size_{0};
+  size_t pos_{0};
+
+  // Current block payload.
+  const uint8_t* block_{nullptr};
+  const uint8_t* block_end_{nullptr};
+
+  std::vector<std::string_view> dict_;
+  int64_t last_ts_{0};
+  std::vector<uint64_t> last_double_;
+  std::vector<FieldView> fields_;
+  size_t corrupt_{0};
+};
+
+}  // namespace bits::ttl
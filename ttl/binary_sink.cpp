@@ -0,0 +1,166 @@
+#include "binary_sink.hpp"
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <utility>
+#include "binary.hpp"
+#include "hash.hpp"
+#include "throw_if_not.hpp"
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+void putFixed32(char* p, uint32_t v) {
+  for (int i = 0; i < 4; ++i) {
+    p[i] = static_cast<char>(v >> (8 * i));
+  }
+}
+}  // namespace
+
+BinaryFile::BinaryFile(std::string_view path, BinaryOptions options)
+    : sink_(open(std::string(path).c_str(),
+                 O_WRONLY | O_APPEND | O_CREAT | O_CLOEXEC, 0644)),
+      options_(options) {
+  const int err = errno;
+  bits::throwIfNot(sink_.fd() >= 0, "ttl: failed to open {}: {}", path,
+                   std::error_code(err, std::generic_category()).message());
+
+  std::string header(binary::kMagic);
+  header.push_back(static_cast<char>(binary::kVersion));
+  header.append(3, '\0');
+  iovec iov{.iov_base = header.data(), .iov_len = header.size()};
+  sink_.writev({&iov, 1});
+
+  block_.assign(binary::kBlockHeaderSize, '\0');
+}
+
+BinaryFile::~BinaryFile() {
+  flush();
+}
+
+void BinaryFile::publish(Event&& event) {
+  publishBatch(Arena::fromEvent(event));
+}
+
+void BinaryFile::publish(const Record& record, const Arena& arena) {
+  encode(record, arena);
+  seal();
+}
+
+void BinaryFile::publishBatch(const Arena& arena) {
+  for (const auto& record : arena.records()) {
+    encode(record, arena);
+    if (block_.size() - binary::kBlockHeaderSize >= options_.block) {
+      seal();
+    }
+  }
+  seal();
+}
+
+void BinaryFile::flush() {
+  seal();
+}
+
+uint64_t BinaryFile::local(Symbol symbol) {
+  if (symbol >= ids_.size()) {
+    ids_.resize(std::bit_ceil(static_cast<size_t>(symbol) + 1), 0);
+    defined_.resize(ids_.size(), 0);
+  }
+  if (ids_[symbol] == 0) {
+    ids_[symbol] = ++next_id_;
+  }
+  // Every block defines what it uses, so losing a block to a bad CRC
+  // does not leave later blocks without their dictionary.
+  if (defined_[symbol] != generation_) {
+    const auto str   = lookup(symbol);
+    defined_[symbol] = generation_;
+    block_.push_back(static_cast<char>(binary::Tag::Symbol));
+    binary::putVarint(block_, ids_[symbol] - 1);
+    binary::putVarint(block_, str.size());
+    block_.append(str);
+  }
+  return ids_[symbol] - 1;
+}
+
+void BinaryFile::encode(const Record& record, const Arena& arena) {
+  // Symbols go first so the record itself stays contiguous.
+  const uint64_t type = local(record.type);
+  const uint64_t name = local(record.name);
+  const auto fields   = arena.fields(record);
+  for (const auto& f : fields) {
+    local(f.key);
+  }
+
+  block_.push_back(static_cast<char>(binary::Tag::Record));
+  binary::putVarint(block_, type);
+  binary::putVarint(block_, name);
+  binary::putVarint(block_, binary::zigzag(record.timestamp - last_ts_));
+  binary::putVarint(block_, fields.size());
+  last_ts_ = record.timestamp;
+
+  for (const auto& f : fields) {
+    const uint64_t key = ids_[f.key] - 1;
+    binary::putVarint(block_, key);
+    switch (f.kind) {
+      case Kind::Int:
+        block_.push_back(static_cast<char>(binary::WireKind::Int));
+        binary::putVarint(block_, binary::zigzag(f.i));
+        break;
+      case Kind::Double: {
+        const auto bits = std::bit_cast<uint64_t>(f.d);
+        if (!options_.xor_doubles) {
+          block_.push_back(static_cast<char>(binary::WireKind::Double));
+          for (int i = 0; i < 8; ++i) {
+            block_.push_back(static_cast<char>(bits >> (8 * i)));
+          }
+          break;
+        }
+        if (key >= last_double_.size()) {
+          last_double_.resize(std::bit_ceil(key + 1), {0, 0});
+        }
+        auto& [gen, prev] = last_double_[key];
+        if (gen != generation_) {
+          gen  = generation_;
+          prev = 0;
+        }
+        block_.push_back(static_cast<char>(binary::WireKind::DoubleXor));
+        binary::putXor(block_, bits ^ prev);
+        prev = bits;
+        break;
+      }
+      case Kind::String: {
+        const auto s = arena.str(f);
+        block_.push_back(static_cast<char>(binary::WireKind::String));
+        binary::putVarint(block_, s.size());
+        block_.append(s);
+        break;
+      }
+    }
+  }
+}
+
+void BinaryFile::seal() {
+  const size_t size = block_.size() - binary::kBlockHeaderSize;
+  if (size == 0) {
+    return;
+  }
+
+  const auto payload = std::as_bytes(
+      std::span(block_).subspan(binary::kBlockHeaderSize));
+  putFixed32(block_.data(), static_cast<uint32_t>(size));
+  putFixed32(block_.data() + 4, bits::crc32c(payload));
+  iovec iov{.iov_base = block_.data(), .iov_len = block_.size()};
+  sink_.writev({&iov, 1});
+
+  block_.resize(binary::kBlockHeaderSize);
+  last_ts_ = 0;
+  generation_++;
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "file_sink.hpp"
+#include "sink.hpp"
+#include "symbols.hpp"
+
+namespace bits::ttl {
+
+struct BinaryOptions {
+  // Payload bytes after which a block is sealed.
+  size_t block = 64 * 1024;
+  // XOR doubles against the previous value of the same key.
+  bool xor_doubles = true;
+};
+
+// Writes the binary segment format (see binary.hpp). Every sink instance
+// starts a new segment, appended to `path`. A block is sealed and written
+// at the end of each batch or once it reaches `block` bytes.
+class BinaryFile : public ISink {
+ public:
+  explicit BinaryFile(std::string_view path, BinaryOptions options = {});
+  ~BinaryFile() override;
+
+  BinaryFile(const BinaryFile&)            = delete;
+  BinaryFile& operator=(const BinaryFile&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+  void flush() override;
+
+ private:
+  uint64_t local(Symbol symbol);
+  void encode(const Record& record, const Arena& arena);
+  void seal();
+
+  Base sink_;
+  BinaryOptions options_;
+  // Global symbol -> segment id + 1, 0 if not assigned yet.
+  std::vector<uint32_t> ids_;
+  // Global symbol -> generation_ of the last block that defined it.
+  std::vector<uint32_t> defined_;
+  uint32_t next_id_{0};
+  // Per block: previous timestamp and previous double per segment key id.
+  int64_t last_ts_{0};
+  uint32_t generation_{1};
+  std::vector<std::pair<uint32_t, uint64_t>> last_double_;
+  std::string block_;
+};
+
+}  // namespace bits::ttl
@@ -0,0 +1,82 @@
+#include "collector.hpp"
+#include <algorithm>
+
+namespace bits::ttl::detail {
+
+CollectorPool::CollectorPool(size_t threads)
+    : arenas_(std::max<size_t>(threads, 1)),
+      ranges_(std::make_unique<Range[]>(arenas_.size())) {
+  threads_.reserve(arenas_.size() - 1);
+  for (size_t i = 1; i < arenas_.size(); ++i) {
+    threads_.emplace_back(
+        [this, i](const std::stop_token& token) { run(i, token); });
+  }
+}
+
+CollectorPool::~CollectorPool() {
+  for (auto& thread : threads_) {
+    thread.request_stop();
+  }
+  round_.fetch_add(1, std::memory_order_release);
+  round_.notify_all();
+  threads_.clear();
+}
+
+std::span<const Arena> CollectorPool::capture(
+    std::span<ITelemetryObject* const> objects) {
+  const size_t n = arenas_.size();
+  for (auto& arena : arenas_) {
+    arena.clear();
+  }
+
+  objects_ = objects;
+  for (size_t i = 0; i < n; ++i) {
+    ranges_[i].next.store(objects.size() * i / n, std::memory_order_relaxed);
+    ranges_[i].end = objects.size() * (i + 1) / n;
+  }
+
+  busy_.store(n - 1, std::memory_order_relaxed);
+  round_.fetch_add(1, std::memory_order_release);
+  round_.notify_all();
+
+  work(0);
+
+  for (size_t left = busy_.load(std::memory_order_acquire); left != 0;
+       left        = busy_.load(std::memory_order_acquire)) {
+    busy_.wait(left, std::memory_order_acquire);
+  }
+  return arenas_;
+}
+
+void CollectorPool::run(size_t self, const std::stop_token& token) {
+  // Rounds start at 1, this thread may start after the first was posted.
+  uint64_t seen = 0;
+  while (true) {
+    round_.wait(seen, std::memory_order_acquire);
+    seen = round_.load(std::memory_order_acquire);
+    if (token.stop_requested()) {
+      return;
+    }
+
+    work(self);
+    if (busy_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      busy_.notify_one();
+    }
+  }
+}
+
+void CollectorPool::work(size_t self) {
+  const size_t n = arenas_.size();
+  auto& arena    = arenas_[self];
+  // Own range first, then steal from the neighbours in turn.
+  for (size_t k = 0; k < n; ++k) {
+    auto& range = ranges_[(self + k) % n];
+    for (size_t i = range.next.fetch_add(1, std::memory_order_relaxed);
+         i < range.end;
+         i = range.next.fetch_add(1, std::memory_order_relaxed)) {
+      objects_[i]->capture(arena);
+    }
+  }
+}
+
+}  // namespace bits::ttl::detail
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <stop_token>
+#include <thread>
+#include <vector>
+#include "telemetry_object.hpp"
+#include "types.hpp"
+
+namespace bits::ttl::detail {
+
+// Captures a set of objects on several threads. The set is split into one
+// contiguous range per thread; a thread that runs out of its own range
+// steals from the others', claiming objects one at a time through the
+// range's atomic cursor. Each thread captures into its own Arena, so a
+// round ends with one batch per thread and no merging under a lock.
+// The calling thread takes part as worker 0.
+class CollectorPool {
+ public:
+  explicit CollectorPool(size_t threads);
+  ~CollectorPool();
+
+  CollectorPool(const CollectorPool&)            = delete;
+  CollectorPool& operator=(const CollectorPool&) = delete;
+
+  [[nodiscard]] size_t size() const noexcept { return arenas_.size(); }
+
+  // Captures every object once; the returned batches stay valid until the
+  // next call. Not reentrant.
+  std::span<const Arena> capture(std::span<ITelemetryObject* const> objects);
+
+ private:
+  struct alignas(64) Range {
+    std::atomic<size_t> next{0};
+    size_t end{0};
+  };
+
+  void run(size_t self, const std::stop_token& token);
+  void work(size_t self);
+
+  std::vector<Arena> arenas_;
+  std::unique_ptr<Range[]> ranges_;
+  std::span<ITelemetryObject* const> objects_;
+
+  std::atomic<uint64_t> round_{0};
+  std::atomic<size_t> busy_{0};
+  std::vector<std::jthread> threads_;
+};
+
+}  // namespace bits::ttl::detail
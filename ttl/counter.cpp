@@ -1,26 +1,100 @@
 #include "counter.hpp"
 #include <bits/algo.hpp>
 #include <chrono>
+#include <format>
 #include <memory>
 #include <string>
 #include "runtime.hpp"
-#include "sink.hpp"
+#include "symbols.hpp"
 #include "telemetry_object.hpp"
+#include "types.hpp"
 
 using std::chrono::steady_clock;
 
 namespace bits::ttl {
 
 namespace detail {
-CounterImpl::CounterImpl(std::string name) : name_(std::move(name)) {}
+namespace {
+// 0.99 -> "p99", 0.999 -> "p99.9". Ten significant digits absorb the
+// rounding error of q * 100 (0.29 * 100 is 28.999999999999996).
+std::string quantileKey(double q) {
+  return std::format("p{:.10g}", q * 100);
+}
+
+struct Keys {
+  Symbol metric  = intern("metric");
+  Symbol summary = intern("summary");
+  Symbol value   = intern("value");
+  Symbol count   = intern("count");
+  Symbol dropped = intern("dropped");
+  Symbol sum     = intern("sum");
+  Symbol min     = intern("min");
+  Symbol max     = intern("max");
+};
+
+const Keys& keys() {
+  static const Keys k;
+  return k;
+}
+}  // namespace
+
+CounterImpl::CounterImpl(std::string name)
+    : CounterImpl(std::move(name), CounterOptions{}) {}
+
+CounterImpl::CounterImpl(std::string name, CounterOptions options)
+    : name_(std::move(name)),
+      symbol_(intern(name_)),
+      options_(std::move(options)) {
+  switch (options_.mode) {
+    case CounterMode::Sample:
+      buffer_ = std::make_unique<bits::MPSCBuffer<double>>(
+          bits::MPSCBufferOptions{.slots    = options_.slots,
+                                  .policy   = options_.sharding,
+                                  .overflow = options_.overflow});
+      break;
+    case CounterMode::Sketch:
+      sketch_ = std::make_unique<bits::MPSCSketch<>>(options_.sharding);
+      quantile_keys_.reserve(options_.quantiles.size());
+      for (const auto& q : options_.quantiles) {
+        quantile_keys_.push_back(intern(quantileKey(q)));
+      }
+      break;
+    case CounterMode::Aggregate:
+      aggregate_ = std::make_unique<bits::Aggregator>();
+      break;
+  }
+}
 
 void CounterImpl::add(double value) {
-  buffer_.append(value);
+  if (buffer_) {
+    buffer_->append(value);
+  } else if (aggregate_) {
+    aggregate_->add(value);
+  } else {
+    sketch_->append(value);
+  }
+}
+
+void CounterImpl::capture(Arena& arena) {
+  switch (options_.mode) {
+    case CounterMode::Sample:
+      return captureSamples(arena);
+    case CounterMode::Sketch:
+      return captureSketch(arena);
+    case CounterMode::Aggregate:
+      return captureAggregate(arena);
+  }
 }
 
-void CounterImpl::capture(ISink& sink) {
+void CounterImpl::attach(std::function<void()> flush) {
+  if (buffer_) {
+    buffer_->onPressure(std::move(flush));
+  }
+}
+
+void CounterImpl::captureSamples(Arena& arena) {
   bits::WeightedReservoirSample<double> sampler;
-  const auto data = buffer_.acquire();
+  const auto data = buffer_->acquire();
 
   if (data.empty()) {
     return;
@@ -32,25 +106,67 @@ void CounterImpl::capture(ISink& sink) {
     return;
   }
 
+  const auto& k      = keys();
+  const auto now     = steady_clock::now().time_since_epoch();
+  const auto dropped = static_cast<int64_t>(buffer_->dropped());
+  const auto count   = static_cast<int64_t>(result.original_count) + dropped;
   for (const auto& value : result.samples) {
-    Event event{
-        .type      = "metric",
-        .name      = std::string(name()),
-        .timestamp = steady_clock::now().time_since_epoch(),
-        .fields    = {{"value", value}, {"count", static_cast<int64_t>(result.original_count)}}};
+    arena.begin(k.metric, symbol_, now);
+    arena.add(k.value, value);
+    arena.add(k.count, count);
+    arena.add(k.dropped, dropped);
+  }
+}
 
-    sink.publish(std::move(event));
+void CounterImpl::captureSketch(Arena& arena) {
+  const auto& sketch = sketch_->acquire();
+
+  if (sketch.empty()) {
+    return;
+  }
+
+  const auto& k = keys();
+  arena.begin(k.summary, symbol_, steady_clock::now().time_since_epoch());
+  arena.add(k.count, static_cast<int64_t>(sketch.count()));
+  arena.add(k.sum, sketch.sum());
+  arena.add(k.min, sketch.min());
+  arena.add(k.max, sketch.max());
+  for (size_t i = 0; i < quantile_keys_.size(); ++i) {
+    arena.add(quantile_keys_[i], sketch.quantile(options_.quantiles[i]));
   }
 }
+
+void CounterImpl::captureAggregate(Arena& arena) {
+  const auto summary = aggregate_->acquire();
+
+  if (summary.empty()) {
+    return;
+  }
+
+  const auto& k = keys();
+  arena.begin(k.summary, symbol_, steady_clock::now().time_since_epoch());
+  arena.add(k.count, static_cast<int64_t>(summary.count));
+  arena.add(k.sum, summary.sum);
+  arena.add(k.min, summary.min);
+  arena.add(k.max, summary.max);
+}
 }  // namespace detail
 
 Counter::Counter(std::string_view name)
     : Counter(name, detail::Runtime::instance()) {};
 
+Counter::Counter(std::string_view name, CounterOptions options)
+    : Counter(name, std::move(options), detail::Runtime::instance()) {};
+
 Counter::Counter(std::string_view name,
                  const std::shared_ptr<detail::Runtime>& rt)
     : impl_(rt->makeObject<detail::CounterImpl>(std::string(name))) {}
 
+Counter::Counter(std::string_view name, CounterOptions options,
+                 const std::shared_ptr<detail::Runtime>& rt)
+    : impl_(rt->makeObject<detail::CounterImpl>(std::string(name),
+                                                std::move(options))) {}
+
 Counter& Counter::operator+=(double value) {
   impl_->add(value);
   return *this;
@@ -1,33 +1,84 @@
 #pragma once
 
+#include <chrono>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <string_view>
+#include <vector>
+#include "aggregator.hpp"
 #include "buffer.hpp"
+#include "cpu.hpp"
 #include "runtime.hpp"
+#include "sketch.hpp"
+#include "symbols.hpp"
 #include "telemetry_object.hpp"
 
 namespace bits::ttl {
 
+enum class CounterMode : uint8_t {
+  // Reservoir sample of the raw values, one event per sample.
+  Sample = 0,
+  // Per-shard DDSketch, one summary event per capture.
+  Sketch = 1,
+  // Thread-local count/sum/min/max, one summary event per capture.
+  Aggregate = 2,
+};
+
+// Options only apply to the first Counter created under a given name.
+struct CounterOptions {
+  CounterMode mode = CounterMode::Sample;
+  // Quantiles reported by `CounterMode::Sketch`, in [0, 1].
+  std::vector<double> quantiles = {0.5, 0.9, 0.99, 0.999};
+  // Per-shard capacity of `CounterMode::Sample`, rounded up to a power of 2.
+  size_t slots = bits::kSlots;
+  // Shard selection for `CounterMode::Sample` and `CounterMode::Sketch`.
+  bits::ShardPolicy sharding = bits::ShardPolicy::Thread;
+  // Values per shard and window `CounterMode::Sample` spills into a
+  // growable overflow segment once its slots are full; anything beyond is
+  // dropped and reported in the `dropped` field.
+  size_t overflow = 0;
+  // Capture interval; zero uses the runtime default (see RuntimeOptions).
+  std::chrono::milliseconds interval{0};
+};
+
 namespace detail {
 struct CounterImpl : public ITelemetryObject {
   explicit CounterImpl(std::string name);
+  explicit CounterImpl(std::string name, CounterOptions options);
 
   void add(double value);
-  void capture(ISink& sink) override;
+  void capture(Arena& arena) override;
+  void attach(std::function<void()> flush) override;
+  [[nodiscard]] std::chrono::milliseconds interval() const override {
+    return options_.interval;
+  }
 
   [[nodiscard]] std::string_view name() const { return name_; }
+  [[nodiscard]] CounterMode mode() const { return options_.mode; }
+
+  void captureSamples(Arena& arena);
+  void captureSketch(Arena& arena);
+  void captureAggregate(Arena& arena);
 
   std::string name_;
-  bits::MPSCBuffer<double> buffer_;
+  Symbol symbol_;
+  CounterOptions options_;
+  std::vector<Symbol> quantile_keys_;
+  std::unique_ptr<bits::MPSCBuffer<double>> buffer_;
+  std::unique_ptr<bits::MPSCSketch<>> sketch_;
+  std::unique_ptr<bits::Aggregator> aggregate_;
 };
 }  // namespace detail
 
 class Counter {
  public:
   explicit Counter(std::string_view name);
+  explicit Counter(std::string_view name, CounterOptions options);
   explicit Counter(std::string_view name,
                    const std::shared_ptr<detail::Runtime>& rt);
+  explicit Counter(std::string_view name, CounterOptions options,
+                   const std::shared_ptr<detail::Runtime>& rt);
 
   Counter& operator+=(double value);
   Counter& operator=(double value);
@@ -0,0 +1,342 @@
+#include "deferred_log.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <charconv>
+#include <format>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "runtime.hpp"
+
+namespace bits::ttl {
+
+namespace {
+struct SiteRegistry {
+  std::mutex mutex;
+  std::vector<const LogSite*> sites;
+};
+
+SiteRegistry& registry() {
+  static SiteRegistry r;
+  return r;
+}
+
+template <typename T>
+bool get(std::span<const std::byte>& in, T& value) {
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  std::memcpy(&value, in.data(), sizeof(T));
+  in = in.subspan(sizeof(T));
+  return true;
+}
+
+bool getString(std::span<const std::byte>& in, std::string_view& value) {
+  uint32_t len = 0;
+  if (!get(in, len) || in.size() < len) {
+    return false;
+  }
+  value = {reinterpret_cast<const char*>(in.data()), len};
+  in    = in.subspan(len);
+  return true;
+}
+
+template <typename T>
+void appendNumber(std::string& out, T value) {
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  if (ec == std::errc()) {
+    out.append(buf, ptr);
+  }
+}
+
+void putString(std::string& out, std::string_view s) {
+  const auto len = static_cast<uint32_t>(s.size());
+  out.append(reinterpret_cast<const char*>(&len), sizeof(len));
+  out.append(s);
+}
+
+bool appendArg(std::string& out, std::span<const std::byte>& args) {
+  uint8_t type = 0;
+  if (!get(args, type)) {
+    return false;
+  }
+  switch (static_cast<deferred::ArgType>(type)) {
+    case deferred::ArgType::Int: {
+      int64_t v = 0;
+      if (!get(args, v)) {
+        return false;
+      }
+      appendNumber(out, v);
+      return true;
+    }
+    case deferred::ArgType::Uint: {
+      uint64_t v = 0;
+      if (!get(args, v)) {
+        return false;
+      }
+      appendNumber(out, v);
+      return true;
+    }
+    case deferred::ArgType::Double: {
+      double v = 0;
+      if (!get(args, v)) {
+        return false;
+      }
+      appendNumber(out, v);
+      return true;
+    }
+    case deferred::ArgType::Bool: {
+      uint8_t v = 0;
+      if (!get(args, v)) {
+        return false;
+      }
+      out.append(v != 0 ? "true" : "false");
+      return true;
+    }
+    case deferred::ArgType::Char: {
+      char v = 0;
+      if (!get(args, v)) {
+        return false;
+      }
+      out.push_back(v);
+      return true;
+    }
+    case deferred::ArgType::String: {
+      std::string_view v;
+      if (!getString(args, v)) {
+        return false;
+      }
+      out.append(v);
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+LogSite::LogSite(LogLevel level, std::string_view format,
+                 std::string_view file, uint32_t line)
+    : level(level), format(format), file(file), line(line) {
+  auto& r = registry();
+  std::unique_lock lock(r.mutex);
+  id = static_cast<uint32_t>(r.sites.size());
+  r.sites.push_back(this);
+}
+
+const LogSite* logSite(uint32_t id) {
+  auto& r = registry();
+  std::unique_lock lock(r.mutex);
+  return id < r.sites.size() ? r.sites[id] : nullptr;
+}
+
+namespace deferred {
+bool format(std::string& out, std::string_view format,
+            std::span<const std::byte> args) {
+  bool ok = true;
+  for (size_t i = 0; i < format.size(); ++i) {
+    const char c = format[i];
+    if ((c == '{' || c == '}') && i + 1 < format.size() &&
+        format[i + 1] == c) {
+      out.push_back(c);
+      ++i;
+    } else if (c == '{' && i + 1 < format.size() && format[i + 1] == '}') {
+      // Missing arguments leave the placeholder in place.
+      if (args.empty() || !appendArg(out, args)) {
+        ok = ok && args.empty();
+        out.append("{}");
+      }
+      ++i;
+    } else {
+      out.push_back(c);
+    }
+  }
+  return ok;
+}
+
+bool decode(std::string_view log, std::string& out) {
+  if (log.size() < kMagic.size() + 1 || !log.starts_with(kMagic) ||
+      static_cast<uint8_t>(log[kMagic.size()]) != kVersion) {
+    return false;
+  }
+
+  struct Site {
+    LogLevel level;
+    uint32_t line;
+    std::string_view file;
+    std::string_view format;
+  };
+  // Site ids are process-wide, so a file holds a sparse subset of them;
+  // keyed by id, memory follows the definitions actually present rather
+  // than whatever id a corrupt file claims.
+  std::unordered_map<uint32_t, Site> sites;
+
+  auto in = std::as_bytes(std::span(log)).subspan(kMagic.size() + 1);
+  while (!in.empty()) {
+    char tag = 0;
+    get(in, tag);
+    if (tag == 'S') {
+      uint32_t id   = 0;
+      uint8_t level = 0;
+      Site site{};
+      if (!get(in, id) || !get(in, level) || !get(in, site.line) ||
+          !getString(in, site.file) || !getString(in, site.format)) {
+        return false;
+      }
+      site.level = static_cast<LogLevel>(level);
+      sites[id]  = site;
+      continue;
+    }
+
+    uint32_t len = 0;
+    if (tag != 'E' || !get(in, len) || in.size() < len) {
+      return false;
+    }
+    auto entry = in.first(len);
+    in         = in.subspan(len);
+
+    uint32_t id = 0;
+    int64_t ts  = 0;
+    if (!get(entry, id) || !get(entry, ts)) {
+      return false;
+    }
+    const auto it = sites.find(id);
+    if (it == sites.end()) {
+      return false;
+    }
+    const auto& site = it->second;
+    appendNumber(out, ts);
+    out.push_back(' ');
+    out.append(logLevelName(site.level));
+    out.push_back(' ');
+    out.append(site.file);
+    out.push_back(':');
+    appendNumber(out, site.line);
+    out.push_back(' ');
+    format(out, site.format, entry);
+    out.push_back('\n');
+  }
+  return true;
+}
+}  // namespace deferred
+
+namespace detail {
+DeferredLoggerImpl::DeferredLoggerImpl(std::string name)
+    : DeferredLoggerImpl(std::move(name), DeferredLogOptions{}) {}
+
+DeferredLoggerImpl::DeferredLoggerImpl(std::string name,
+                                       DeferredLogOptions options)
+    : name_(std::move(name)),
+      options_(std::move(options)),
+      symbol_(intern(name_)),
+      type_(intern("log")),
+      level_key_(intern("level")),
+      message_key_(intern("message")) {
+  if (options_.path.empty()) {
+    return;
+  }
+
+  fd_ = ::open(options_.path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+               0644);
+  if (fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::format("ttl: failed to open {}", options_.path));
+  }
+  out_.append(deferred::kMagic);
+  out_.push_back(static_cast<char>(deferred::kVersion));
+}
+
+DeferredLoggerImpl::~DeferredLoggerImpl() {
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+const LogSite* DeferredLoggerImpl::site(uint32_t id) {
+  if (id >= sites_.size()) {
+    sites_.resize(id + 1, nullptr);
+  }
+  if (sites_[id] == nullptr) {
+    sites_[id] = logSite(id);
+  }
+  return sites_[id];
+}
+
+void DeferredLoggerImpl::capture(Arena& arena) {
+  rings_.forEach([&](bits::SPSCByteRing& ring, bool /*orphaned*/) {
+    if (!ring.ready()) {
+      return;
+    }
+
+    for (auto entry = ring.front(); !entry.empty(); entry = ring.front()) {
+      uint32_t id = 0;
+      int64_t ts  = 0;
+      std::memcpy(&id, entry.data(), sizeof(id));
+      std::memcpy(&ts, entry.data() + sizeof(id), sizeof(ts));
+      const auto* s = site(id);
+      ring.pop(entry);
+      if (s == nullptr) {
+        continue;
+      }
+
+      if (fd_ >= 0) {
+        if (id >= written_.size()) {
+          written_.resize(id + 1, false);
+        }
+        if (!written_[id]) {
+          written_[id] = true;
+          out_.push_back('S');
+          out_.append(reinterpret_cast<const char*>(&id), sizeof(id));
+          out_.push_back(static_cast<char>(s->level));
+          out_.append(reinterpret_cast<const char*>(&s->line), sizeof(s->line));
+          putString(out_, s->file);
+          putString(out_, s->format);
+        }
+        out_.push_back('E');
+        putString(out_, {reinterpret_cast<const char*>(entry.data()),
+                         entry.size()});
+        continue;
+      }
+
+      message_.clear();
+      deferred::format(message_, s->format,
+                       entry.subspan(deferred::kEntryHeader));
+      arena.begin(type_, symbol_, std::chrono::nanoseconds(ts));
+      arena.add(level_key_, logLevelName(s->level));
+      arena.add(message_key_, std::string_view(message_));
+    }
+    ring.release();
+  });
+
+  const char* p = out_.data();
+  size_t left   = out_.size();
+  while (fd_ >= 0 && left != 0) {
+    const ssize_t n = ::write(fd_, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
+    p += n;
+    left -= static_cast<size_t>(n);
+  }
+  out_.clear();
+}
+}  // namespace detail
+
+DeferredLogger& DeferredLogger::instance() {
+  static DeferredLogger logger{
+      detail::Runtime::instance()->makeObject<detail::DeferredLoggerImpl>(
+          "logf")};
+  return logger;
+}
+
+DeferredLogger::DeferredLogger(const std::shared_ptr<detail::Runtime>& runtime,
+                               DeferredLogOptions options)
+    : impl_(runtime->makeObject<detail::DeferredLoggerImpl>(
+          "logf", std::move(options))) {}
+
+}  // namespace bits::ttl
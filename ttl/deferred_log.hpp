@@ -0,0 +1,233 @@
+#pragma once
+
+#include <bits/spsc_ring.hpp>
+#include <bits/thread_slots.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+#include "logger.hpp"
+#include "symbols.hpp"
+#include "telemetry_object.hpp"
+#include "types.hpp"
+
+namespace bits::ttl {
+
+// A TTL_LOGF call site: level, format and location, registered once and
+// referred to by id from then on.
+struct LogSite {
+  LogSite(LogLevel level, std::string_view format, std::string_view file,
+          uint32_t line);
+
+  LogLevel level;
+  std::string_view format;
+  std::string_view file;
+  uint32_t line;
+  uint32_t id;
+};
+
+// The site registered under `id`, nullptr if none.
+const LogSite* logSite(uint32_t id);
+
+namespace deferred {
+// Argument encoding: a type byte, then the value in host byte order.
+enum class ArgType : uint8_t {
+  Int    = 0,  // int64
+  Uint   = 1,  // uint64
+  Double = 2,  // double
+  Bool   = 3,  // uint8
+  Char   = 4,  // char
+  String = 5,  // u32 length, bytes
+};
+
+template <typename T>
+constexpr bool kStringLike = std::is_convertible_v<const T&, std::string_view>;
+
+template <typename T>
+size_t argSize(const T& value) {
+  if constexpr (kStringLike<T>) {
+    return 1 + sizeof(uint32_t) + std::string_view(value).size();
+  } else if constexpr (std::is_same_v<T, bool> || std::is_same_v<T, char>) {
+    return 2;
+  } else {
+    static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T>,
+                  "TTL_LOGF takes numbers, chars, bools and strings");
+    return 1 + 8;
+  }
+}
+
+inline std::byte* put(std::byte* p, const void* src, size_t n) {
+  std::memcpy(p, src, n);
+  return p + n;
+}
+
+template <typename T>
+std::byte* putArg(std::byte* p, const T& value) {
+  const auto tag = [&](ArgType type) {
+    *p++ = static_cast<std::byte>(type);
+  };
+  if constexpr (kStringLike<T>) {
+    const std::string_view s(value);
+    const auto len = static_cast<uint32_t>(s.size());
+    tag(ArgType::String);
+    p = put(p, &len, sizeof(len));
+    return put(p, s.data(), s.size());
+  } else if constexpr (std::is_same_v<T, bool>) {
+    tag(ArgType::Bool);
+    *p = static_cast<std::byte>(value ? 1 : 0);
+    return p + 1;
+  } else if constexpr (std::is_same_v<T, char>) {
+    tag(ArgType::Char);
+    *p = static_cast<std::byte>(value);
+    return p + 1;
+  } else if constexpr (std::is_floating_point_v<T>) {
+    const auto v = static_cast<double>(value);
+    tag(ArgType::Double);
+    return put(p, &v, sizeof(v));
+  } else if constexpr (std::is_enum_v<T>) {
+    return putArg(p, static_cast<std::underlying_type_t<T>>(value));
+  } else if constexpr (std::is_signed_v<T>) {
+    const auto v = static_cast<int64_t>(value);
+    tag(ArgType::Int);
+    return put(p, &v, sizeof(v));
+  } else {
+    const auto v = static_cast<uint64_t>(value);
+    tag(ArgType::Uint);
+    return put(p, &v, sizeof(v));
+  }
+}
+
+// Entry layout in the per-thread ring and the binary log:
+//   u32 site | i64 timestamp (ns) | args...
+constexpr size_t kEntryHeader = sizeof(uint32_t) + sizeof(int64_t);
+
+// Binary log written with DeferredLogOptions::path:
+//   "TTLL" | u8 version, then a sequence of
+//   'S' | u32 id | u8 level | u32 line | u32 len | file | u32 len | format
+//   'E' | u32 len | entry
+// Each site is defined before its first entry.
+constexpr std::string_view kMagic = "TTLL";
+constexpr uint8_t kVersion        = 1;
+
+// Appends one line per entry of a binary log:
+//   <ts> <level> <file>:<line> <message>
+// Returns false if the log is truncated or malformed.
+bool decode(std::string_view log, std::string& out);
+
+// Appends `format` with each "{}" replaced by the next encoded argument
+// ("{{" and "}}" are literal braces). Returns false on malformed args.
+bool format(std::string& out, std::string_view format,
+            std::span<const std::byte> args);
+}  // namespace deferred
+
+struct DeferredLogOptions {
+  // Per-thread ring; a full ring drops new entries.
+  size_t buffer = 64 << 10;
+  // Write entries in binary to this file (see log_decode) instead of
+  // formatting them into log records.
+  std::string path;
+};
+
+namespace detail {
+class Runtime;
+
+struct DeferredLoggerImpl : public ITelemetryObject {
+  explicit DeferredLoggerImpl(std::string name);
+  DeferredLoggerImpl(std::string name, DeferredLogOptions options);
+  ~DeferredLoggerImpl() override;
+
+  template <typename... Args>
+  void log(const LogSite& site, const Args&... args) {
+    auto& ring = rings_.local();
+    if (!ring.ready()) [[unlikely]] {
+      ring.init(options_.buffer);
+    }
+
+    const size_t size = deferred::kEntryHeader + (0 + ... + deferred::argSize(args));
+    std::byte* p      = ring.reserve(size);
+    if (p == nullptr) [[unlikely]] {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+
+    const int64_t ts =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    p = deferred::put(p, &site.id, sizeof(site.id));
+    p = deferred::put(p, &ts, sizeof(ts));
+    ((p = deferred::putArg(p, args)), ...);
+    ring.commit(size);
+  }
+
+  void capture(Arena& arena) override;
+
+  [[nodiscard]] size_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  const LogSite* site(uint32_t id);
+
+  std::string name_;
+  DeferredLogOptions options_;
+  bits::ThreadSlots<bits::SPSCByteRing> rings_;
+  std::atomic<size_t> dropped_{0};
+
+  // Flush thread only.
+  Symbol symbol_;
+  Symbol type_;
+  Symbol level_key_;
+  Symbol message_key_;
+  std::string message_;
+  int fd_{-1};
+  std::string out_;
+  std::vector<bool> written_;
+  std::vector<const LogSite*> sites_;
+};
+}  // namespace detail
+
+// Logs a format-site id plus the raw argument bytes into a per-thread
+// ring; formatting happens on the flush thread (or offline, with
+// DeferredLogOptions::path and log_decode).
+class DeferredLogger {
+ public:
+  static DeferredLogger& instance();
+  explicit DeferredLogger(const std::shared_ptr<detail::Runtime>& runtime,
+                          DeferredLogOptions options = {});
+
+  template <typename... Args>
+  void log(const LogSite& site, const Args&... args) {
+    impl_->log(site, args...);
+  }
+
+  // Entries lost to a full ring.
+  [[nodiscard]] size_t dropped() const noexcept { return impl_->dropped(); }
+
+ private:
+  explicit DeferredLogger(std::shared_ptr<detail::DeferredLoggerImpl> impl)
+      : impl_(std::move(impl)) {}
+
+  std::shared_ptr<detail::DeferredLoggerImpl> impl_;
+};
+
+// TTL_LOGF(Info, "served {} in {}us", path, micros);
+// Filtered by the root LogModule's level, like TTL_LOG.
+#define TTL_LOGF(level, fmt, ...)                                          \
+  do {                                                                     \
+    if constexpr (TTL_LOG_ENABLED(level)) {                                \
+      static constinit ::bits::ttl::LogGate ttl_log_gate_{""};             \
+      if (ttl_log_gate_.enabled(level)) {                                  \
+        static const ::bits::ttl::LogSite ttl_log_site_{level, fmt,        \
+                                                        __FILE__, __LINE__}; \
+        ::bits::ttl::DeferredLogger::instance().log(                       \
+            ttl_log_site_ __VA_OPT__(, ) __VA_ARGS__);                     \
+      }                                                                    \
+    }                                                                      \
+  } while (false)
+
+}  // namespace bits::ttl
@@ -1,12 +1,29 @@
 #include "file_sink.hpp"
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <charconv>
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <condition_variable>
 #include <cstring>
+#include <deque>
+#include <filesystem>
+#include <format>
+#include <mutex>
+#include <stop_token>
 #include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "json.hpp"
 #include "throw_if_not.hpp"
 #include "types.hpp"
 
@@ -24,86 +41,439 @@ Base::~Base() {
   return fd_;
 }
 
+namespace {
+// Batches are written out once the encoded lines exceed this.
+constexpr size_t kWriteChunk = 64 * 1024;
+}  // namespace
+
 void Base::publish(Event&& event) {
   if (fd_ < 0) {
     return;
   }
 
-  char buf[4096];
-  char* p   = buf;
-  char* end = buf + sizeof(buf) - 1;
+  encodeJson(out_, event);
+  write();
+}
+
+void Base::publish(const Record& record, const Arena& arena) {
+  if (fd_ < 0) {
+    return;
+  }
+
+  encodeJson(out_, record, arena);
+  write();
+}
+
+void Base::publishBatch(const Arena& arena) {
+  if (fd_ < 0) {
+    return;
+  }
 
-  auto append = [&](const char* s) {
-    while (*s && p < end) {
-      *p++ = *s++;
+  for (const auto& record : arena.records()) {
+    encodeJson(out_, record, arena);
+    if (out_.size() >= kWriteChunk) {
+      write();
     }
-  };
+  }
+  write();
+}
 
-  auto append_sv = [&](std::string_view sv) {
-    size_t n = std::min(static_cast<size_t>(end - p), sv.size());
-    std::memcpy(p, sv.data(), n);
+void Base::write() {
+  const char* p = out_.data();
+  size_t left   = out_.size();
+  while (left != 0) {
+    const ssize_t n = ::write(fd_, p, left);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
+    }
     p += n;
-  };
+    left -= static_cast<size_t>(n);
+    written_ += static_cast<size_t>(n);
+  }
+  out_.clear();
+}
 
-  auto append_int = [&](int64_t val) {
-    auto [ptr, ec] = std::to_chars(p, end, val);
-    if (ec == std::errc()) {
-      p = ptr;
+void Base::writev(std::span<iovec> iov) {
+  // writev() takes at most IOV_MAX entries and may write partially.
+  size_t first = 0;
+  while (first < iov.size()) {
+    const int n = static_cast<int>(std::min<size_t>(iov.size() - first, IOV_MAX));
+    ssize_t wrote = ::writev(fd_, iov.data() + first, n);
+    if (wrote < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      break;
     }
-  };
+    written_ += static_cast<size_t>(wrote);
+    while (first < iov.size() && static_cast<size_t>(wrote) >= iov[first].iov_len) {
+      wrote -= static_cast<ssize_t>(iov[first].iov_len);
+      first++;
+    }
+    if (first < iov.size()) {
+      iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + wrote;
+      iov[first].iov_len -= static_cast<size_t>(wrote);
+    }
+  }
+}
+
+int Base::exchange(int fd, size_t written) noexcept {
+  written_ = written;
+  return std::exchange(fd_, fd);
+}
+
+namespace detail {
+// Owns everything about rotation that touches the file system besides
+// the live fd. Work is queued and done in order on its own thread.
+class Rotator {
+ public:
+  Rotator(std::string path, size_t prealloc, size_t retain)
+      : path_(std::move(path)),
+        next_(path_ + ".next"),
+        prealloc_(prealloc),
+        retain_(retain),
+        seq_(lastSegment() + 1),
+        thread_([this](const std::stop_token& token) { run(token); }) {}
+
+  ~Rotator() {
+    thread_.request_stop();
+    thread_.join();
+    if (ready_ >= 0) {
+      ::close(ready_);
+      ::unlink(next_.c_str());
+    }
+  }
+
+  Rotator(const Rotator&)            = delete;
+  Rotator& operator=(const Rotator&) = delete;
 
-  auto append_double = [&](double val) {
-    auto [ptr, ec] = std::to_chars(p, end, val);
-    if (ec == std::errc()) {
-      p = ptr;
+  // Prepared segment, or -1 if it is not ready yet. Never blocks.
+  int take() {
+    std::unique_lock lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return -1;
     }
+    return std::exchange(ready_, -1);
+  }
+
+  // Hands over the completed segment taken out of service by take().
+  void retire(int fd, size_t size) {
+    {
+      std::unique_lock lock(mutex_);
+      retired_.push_back({fd, size});
+    }
+    cond_.notify_one();
+  }
+
+  // Failed attempts to open the next segment.
+  [[nodiscard]] size_t errors() const noexcept {
+    return errors_.load(std::memory_order_relaxed);
+  }
+
+  void reserve(int fd) const {
+    if (prealloc_ != 0) {
+      // Best effort, not every file system supports it.
+      ::fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(prealloc_));
+    }
+  }
+
+ private:
+  struct Retired {
+    int fd;
+    size_t size;
   };
 
-  append(R"({"type":")");
-  append_sv(event.type);
-  append(R"(","name":")");
-  append_sv(event.name);
-  append(R"(","ts":)");
-  append_int(event.timestamp.count());
-
-  for (auto& field : event.fields) {
-    append(",\"");
-    append_sv(field.key);
-    append("\":");
-    std::visit(
-        [&](auto&& v) {
-          using T = std::decay_t<decltype(v)>;
-          if constexpr (std::is_same_v<T, int64_t>) {
-            append_int(v);
-          } else if constexpr (std::is_same_v<T, double>) {
-            append_double(v);
-          } else if constexpr (std::is_same_v<T, std::string_view>) {
-            append("\"");
-            append_sv(v);
-            append("\"");
-          }
-        },
-        field.value);
-  }
-
-  append("}\n");
-
-  size_t len = p - buf;
-  ::write(fd_, buf, len);
-}
-
-File::File(std::string_view path)
+  static constexpr std::chrono::milliseconds kRetry{250};
+
+  void run(const std::stop_token& token) {
+    prepare();
+    while (true) {
+      std::unique_lock lock(mutex_);
+      const auto pending = [&] { return !retired_.empty(); };
+      if (!failed_) {
+        cond_.wait(lock, token, pending);
+      } else {
+        // Rotation stalls until a segment is prepared, and no retire()
+        // comes before that, so a failed open is retried on a timer.
+        cond_.wait_for(lock, token, kRetry, pending);
+      }
+      if (retired_.empty()) {
+        if (token.stop_requested()) {
+          return;
+        }
+        lock.unlock();
+        prepare();
+        continue;
+      }
+      const Retired r = retired_.front();
+      retired_.pop_front();
+      lock.unlock();
+
+      complete(r);
+      prepare();
+    }
+  }
+
+  void prepare() {
+    const int fd = ::open(next_.c_str(),
+                          O_WRONLY | O_APPEND | O_CREAT | O_TRUNC | O_CLOEXEC,
+                          0644);
+    if (fd < 0) {
+      errors_.fetch_add(1, std::memory_order_relaxed);
+      std::unique_lock lock(mutex_);
+      failed_ = true;
+      return;
+    }
+    reserve(fd);
+
+    std::unique_lock lock(mutex_);
+    ready_  = fd;
+    failed_ = false;
+  }
+
+  void complete(const Retired& r) {
+    ::rename(path_.c_str(), std::format("{}.{:06}", path_, seq_++).c_str());
+    ::rename(next_.c_str(), path_.c_str());
+    // Gives back preallocated space past the end of the segment.
+    ::ftruncate(r.fd, static_cast<off_t>(r.size));
+    ::close(r.fd);
+
+    if (retain_ == 0) {
+      return;
+    }
+    auto segments = list();
+    if (segments.size() <= retain_) {
+      return;
+    }
+    std::ranges::sort(segments);
+    for (size_t i = 0; i < segments.size() - retain_; ++i) {
+      std::error_code ec;
+      std::filesystem::remove(segments[i].second, ec);
+    }
+  }
+
+  // Completed segments as (seq, path).
+  [[nodiscard]] std::vector<std::pair<uint64_t, std::filesystem::path>> list()
+      const {
+    std::vector<std::pair<uint64_t, std::filesystem::path>> out;
+    const std::filesystem::path live(path_);
+    const auto prefix = live.filename().string() + ".";
+    auto dir          = live.parent_path();
+    if (dir.empty()) {
+      dir = ".";
+    }
+
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+      const auto name = entry.path().filename().string();
+      if (!name.starts_with(prefix)) {
+        continue;
+      }
+      const std::string_view digits =
+          std::string_view(name).substr(prefix.size());
+      uint64_t seq   = 0;
+      const auto& rc = std::from_chars(digits.data(),
+                                       digits.data() + digits.size(), seq);
+      if (digits.empty() || rc.ec != std::errc{} ||
+          rc.ptr != digits.data() + digits.size()) {
+        continue;
+      }
+      out.emplace_back(seq, entry.path());
+    }
+    return out;
+  }
+
+  [[nodiscard]] uint64_t lastSegment() const {
+    uint64_t last = 0;
+    for (const auto& [seq, path] : list()) {
+      last = std::max(last, seq);
+    }
+    return last;
+  }
+
+  const std::string path_;
+  const std::string next_;
+  const size_t prealloc_;
+  const size_t retain_;
+  uint64_t seq_;
+
+  std::mutex mutex_;
+  std::condition_variable_any cond_;
+  int ready_{-1};
+  // The last prepare() failed; until one succeeds there is nothing to
+  // take() and so nothing is ever retired.
+  bool failed_{false};
+  std::deque<Retired> retired_;
+  std::atomic<size_t> errors_{0};
+
+  std::jthread thread_;
+};
+}  // namespace detail
+
+File::File(std::string_view path, FileOptions options)
     : sink_(open(std::string(path).c_str(), O_WRONLY | O_APPEND | O_CREAT,
-                 0644)) {
+                 0644)),
+      options_(options),
+      last_flush_(std::chrono::steady_clock::now()) {
   const int err = errno;
   bits::throwIfNot(sink_.fd() >= 0, "ttl: failed to open {}: {}", path,
                    std::error_code(err, std::generic_category()).message());
+
+  if (options_.rotate_bytes == 0 && options_.rotate_interval.count() == 0) {
+    return;
+  }
+
+  // Existing contents count toward the first segment.
+  struct stat st{};
+  if (::fstat(sink_.fd(), &st) == 0) {
+    sink_.exchange(sink_.fd(), static_cast<size_t>(st.st_size));
+  }
+  rotator_ = std::make_unique<detail::Rotator>(
+      std::string(path), options_.rotate_bytes, options_.retain);
+  rotator_->reserve(sink_.fd());
+  rotate_at_ = std::chrono::system_clock::time_point::max();
+  if (options_.rotate_interval.count() != 0) {
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    rotate_at_     = std::chrono::system_clock::time_point(
+        (now / options_.rotate_interval + 1) * options_.rotate_interval);
+  }
 }
 
-File::~File() = default;
+File::~File() {
+  flush();
+  if (rotator_) {
+    ::ftruncate(sink_.fd(), static_cast<off_t>(sink_.written()));
+    rotator_.reset();
+  }
+}
 
 void File::publish(Event&& event) {
-  sink_.publish(std::move(event));
+  if (options_.buffer == 0) {
+    sink_.publish(std::move(event));
+    rotate();
+    return;
+  }
+
+  auto& out         = block();
+  const size_t size = out.size();
+  encodeJson(out, event);
+  commit(out.size() - size);
+}
+
+void File::publish(const Record& record, const Arena& arena) {
+  if (options_.buffer == 0) {
+    sink_.publish(record, arena);
+    rotate();
+    return;
+  }
+
+  auto& out         = block();
+  const size_t size = out.size();
+  encodeJson(out, record, arena);
+  commit(out.size() - size);
+}
+
+void File::publishBatch(const Arena& arena) {
+  if (options_.buffer == 0) {
+    sink_.publishBatch(arena);
+    rotate();
+    return;
+  }
+
+  for (const auto& record : arena.records()) {
+    auto& out         = block();
+    const size_t size = out.size();
+    encodeJson(out, record, arena);
+    pending_ += out.size() - size;
+    if (pending_ >= options_.buffer) {
+      flush();
+    }
+  }
+  commit(0);
+}
+
+std::string& File::block() {
+  if (blocks_.empty() || blocks_.back().size() >= kWriteChunk) {
+    if (spare_.empty()) {
+      blocks_.emplace_back().reserve(kWriteChunk);
+    } else {
+      blocks_.push_back(std::move(spare_.back()));
+      spare_.pop_back();
+    }
+  }
+  return blocks_.back();
+}
+
+void File::commit(size_t bytes) {
+  pending_ += bytes;
+  if (pending_ >= options_.buffer ||
+      std::chrono::steady_clock::now() - last_flush_ >=
+          options_.flush_interval) {
+    flush();
+  }
+}
+
+void File::flush() {
+  last_flush_ = std::chrono::steady_clock::now();
+  if (blocks_.empty()) {
+    // A rotation that waited for the next segment is retried here too.
+    rotate();
+    return;
+  }
+
+  std::vector<iovec> iov;
+  iov.reserve(blocks_.size());
+  for (auto& b : blocks_) {
+    if (!b.empty()) {
+      iov.push_back({.iov_base = b.data(), .iov_len = b.size()});
+    }
+  }
+
+  sink_.writev(iov);
+
+  // Keep blocks for reuse, except ones grown by oversized records.
+  for (auto& b : blocks_) {
+    if (b.capacity() <= 2 * kWriteChunk &&
+        spare_.size() * kWriteChunk < options_.buffer) {
+      b.clear();
+      spare_.push_back(std::move(b));
+    }
+  }
+  blocks_.clear();
+  pending_ = 0;
+  rotate();
+}
+
+size_t File::rotateErrors() const noexcept {
+  return rotator_ ? rotator_->errors() : 0;
+}
+
+void File::rotate() {
+  if (!rotator_) {
+    return;
+  }
+
+  const bool full = options_.rotate_bytes != 0 &&
+                    sink_.written() >= options_.rotate_bytes;
+  if (!full && std::chrono::system_clock::now() < rotate_at_) {
+    return;
+  }
+
+  const int fd = rotator_->take();
+  if (fd < 0) {
+    return;
+  }
+
+  const size_t size = sink_.written();
+  rotator_->retire(sink_.exchange(fd), size);
+  if (options_.rotate_interval.count() != 0) {
+    const auto now = std::chrono::system_clock::now().time_since_epoch();
+    rotate_at_     = std::chrono::system_clock::time_point(
+        (now / options_.rotate_interval + 1) * options_.rotate_interval);
+  }
 }
 
 }  // namespace bits::ttl
@@ -1,5 +1,13 @@
 #pragma once
 
+#include <sys/uio.h>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
 #include "sink.hpp"
 
 namespace bits::ttl {
@@ -10,30 +18,94 @@ class Base : public ISink {
   ~Base() override;
 
   void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  // Encodes the whole batch into one buffer and writes it in large chunks.
+  void publishBatch(const Arena& arena) override;
+
+  // Writes all of `iov`, retrying short writes.
+  void writev(std::span<iovec> iov);
 
   [[nodiscard]] int fd() const;
+  // Bytes written to the current fd.
+  [[nodiscard]] size_t written() const noexcept { return written_; }
+  // Switches to `fd` and returns the previous one, which the caller owns.
+  int exchange(int fd, size_t written = 0) noexcept;
 
  private:
+  void write();
+
   int fd_{-1};
+  size_t written_{0};
+  // Reused across publishes; only touched from the publishing thread.
+  std::string out_;
+};
+
+struct FileOptions {
+  // Bytes to coalesce before writing, 0 writes every batch through.
+  size_t buffer = 0;
+  // Upper bound on how long buffered output may sit unwritten.
+  std::chrono::milliseconds flush_interval{1000};
+  // Start a new segment once the current one reaches this size, 0 never.
+  size_t rotate_bytes = 0;
+  // Start a new segment at every multiple of this wall-clock interval
+  // (since the epoch, so 1h rotates on the hour), 0 never.
+  std::chrono::milliseconds rotate_interval{0};
+  // Completed segments to keep, oldest are deleted first; 0 keeps all.
+  size_t retain = 0;
 };
 
+namespace detail {
+class Rotator;
+}
+
+// With `buffer` set, records are encoded into a chain of reusable blocks
+// and written with a single writev() once `buffer` bytes are pending or
+// `flush_interval` has passed, plus on flush() and destruction. Records
+// larger than a block grow that block instead of being truncated.
+//
+// With rotation enabled `path` is always the live segment. Completed
+// segments are renamed to `path.<seq>`. A background thread prepares
+// (and preallocates) the next segment as `path.next`, does the renames
+// and applies `retain`; the publishing thread only swaps file descriptors
+// and keeps writing the current segment if the next one is not ready.
 class File : public ISink {
  public:
-  explicit File(std::string_view path);
+  explicit File(std::string_view path, FileOptions options = {});
   ~File() override;
 
   File(const File&)            = delete;
   File& operator=(const File&) = delete;
 
   void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+  void flush() override;
+
+  // Failed attempts to prepare the next segment. Rotation waits, and the
+  // live segment keeps growing, until one succeeds.
+  [[nodiscard]] size_t rotateErrors() const noexcept;
 
  private:
+  std::string& block();
+  void commit(size_t before);
+  void rotate();
+
   Base sink_;
+  FileOptions options_;
+  std::unique_ptr<detail::Rotator> rotator_;
+  std::chrono::system_clock::time_point rotate_at_;
+  std::chrono::steady_clock::time_point last_flush_;
+  // Pending blocks, the last one is being filled.
+  std::vector<std::string> blocks_;
+  std::vector<std::string> spare_;
+  size_t pending_{0};
 };
 
 class Discard : public ISink {
  public:
   void publish(Event&& /*event*/) override {};
+  void publish(const Record& /*record*/, const Arena& /*arena*/) override {};
+  void publishBatch(const Arena& /*arena*/) override {};
 };
 
 class StdOut : public ISink {
@@ -41,6 +113,10 @@ class StdOut : public ISink {
   explicit StdOut() : sink_(1) {};
 
   void publish(Event&& event) override { sink_.publish(std ::move(event)); }
+  void publish(const Record& record, const Arena& arena) override {
+    sink_.publish(record, arena);
+  }
+  void publishBatch(const Arena& arena) override { sink_.publishBatch(arena); }
 
  private:
   Base sink_;
@@ -0,0 +1,191 @@
+#include "json.hpp"
+#include <simde/x86/sse2.h>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <variant>
+#include "symbols.hpp"
+
+namespace bits::ttl {
+
+namespace {
+constexpr bool needsEscape(char c) noexcept {
+  return c == '"' || c == '\\' || static_cast<unsigned char>(c) < 0x20;
+}
+
+// Offset of the first byte needing an escape in [p, p + n), or n.
+size_t findEscape(const char* p, size_t n) noexcept {
+  const auto quote   = simde_mm_set1_epi8('"');
+  const auto slash   = simde_mm_set1_epi8('\\');
+  const auto control = simde_mm_set1_epi8(0x1f);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const auto v = simde_mm_loadu_si128(
+        reinterpret_cast<const simde__m128i*>(p + i));
+    // max(v, 0x1f) == 0x1f exactly for the (unsigned) control bytes.
+    const auto hit = simde_mm_or_si128(
+        simde_mm_or_si128(simde_mm_cmpeq_epi8(v, quote),
+                          simde_mm_cmpeq_epi8(v, slash)),
+        simde_mm_cmpeq_epi8(simde_mm_max_epu8(v, control), control));
+    const auto mask = static_cast<uint32_t>(simde_mm_movemask_epi8(hit));
+    if (mask != 0) {
+      return i + static_cast<size_t>(std::countr_zero(mask));
+    }
+  }
+  for (; i < n; ++i) {
+    if (needsEscape(p[i])) {
+      return i;
+    }
+  }
+  return n;
+}
+
+void appendEscape(std::string& out, char c) {
+  switch (c) {
+    case '"':
+      out.append("\\\"");
+      return;
+    case '\\':
+      out.append("\\\\");
+      return;
+    case '\n':
+      out.append("\\n");
+      return;
+    case '\r':
+      out.append("\\r");
+      return;
+    case '\t':
+      out.append("\\t");
+      return;
+    case '\b':
+      out.append("\\b");
+      return;
+    case '\f':
+      out.append("\\f");
+      return;
+    default: {
+      constexpr std::string_view hex = "0123456789abcdef";
+      const auto u                   = static_cast<unsigned char>(c);
+      const char buf[] = {'\\', 'u', '0', '0', hex[u >> 4], hex[u & 0xf]};
+      out.append(buf, sizeof(buf));
+    }
+  }
+}
+
+// Appends JSON lines to a caller-owned buffer.
+class JsonWriter {
+ public:
+  explicit JsonWriter(std::string& out) : out_(out) {}
+
+  void append(std::string_view sv) { out_.append(sv); }
+
+  template <typename T>
+  void appendNumber(T val) {
+    if constexpr (std::is_floating_point_v<T>) {
+      if (!std::isfinite(val)) {
+        append("null");
+        return;
+      }
+    }
+    // Plain to_chars is the shortest form that round-trips.
+    char buf[32];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), val);
+    if (ec == std::errc()) {
+      out_.append(buf, ptr);
+    }
+  }
+
+  void appendString(std::string_view sv) {
+    out_.push_back('"');
+    appendJsonEscaped(out_, sv);
+    out_.push_back('"');
+  }
+
+  void header(std::string_view type, std::string_view name, int64_t ts) {
+    append(R"({"type":")");
+    appendJsonEscaped(out_, type);
+    append(R"(","name":")");
+    appendJsonEscaped(out_, name);
+    append(R"(","ts":)");
+    appendNumber(ts);
+  }
+
+  void key(std::string_view key) {
+    append(",\"");
+    appendJsonEscaped(out_, key);
+    append("\":");
+  }
+
+  void finish() { append("}\n"); }
+
+ private:
+  std::string& out_;
+};
+}  // namespace
+
+void appendJsonEscaped(std::string& out, std::string_view str) {
+  const char* p = str.data();
+  size_t n      = str.size();
+  while (n != 0) {
+    const size_t clean = findEscape(p, n);
+    out.append(p, clean);
+    if (clean == n) {
+      return;
+    }
+    appendEscape(out, p[clean]);
+    p += clean + 1;
+    n -= clean + 1;
+  }
+}
+
+void encodeJson(std::string& out, const Event& event) {
+  JsonWriter w(out);
+  w.header(event.type, event.name, event.timestamp.count());
+  for (const auto& field : event.fields) {
+    w.key(field.key);
+    std::visit(
+        [&](auto&& v) {
+          using T = std::decay_t<decltype(v)>;
+          if constexpr (std::is_same_v<T, std::string>) {
+            w.appendString(v);
+          } else {
+            w.appendNumber(v);
+          }
+        },
+        field.value);
+  }
+  w.finish();
+}
+
+void encodeJson(std::string& out, const Record& record, const Arena& arena) {
+  JsonWriter w(out);
+  w.header(lookup(record.type), lookup(record.name), record.timestamp);
+  for (const auto& field : arena.fields(record)) {
+    w.key(lookup(field.key));
+    switch (field.kind) {
+      case Kind::Int:
+        w.appendNumber(field.i);
+        break;
+      case Kind::Double:
+        w.appendNumber(field.d);
+        break;
+      case Kind::String:
+        w.appendString(arena.str(field));
+        break;
+    }
+  }
+  w.finish();
+}
+
+void encodeJson(std::string& out, const Arena& arena) {
+  for (const auto& record : arena.records()) {
+    encodeJson(out, record, arena);
+  }
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include "types.hpp"
+
+namespace bits::ttl {
+
+// Appends one JSON line ({"type":..,"name":..,"ts":..,<fields>}\n).
+// Names, keys and strings are escaped, non-finite doubles become null.
+void encodeJson(std::string& out, const Event& event);
+void encodeJson(std::string& out, const Record& record, const Arena& arena);
+
+// Appends one line per record of the batch.
+void encodeJson(std::string& out, const Arena& arena);
+
+// Appends `str` escaped for a JSON string, without the quotes.
+void appendJsonEscaped(std::string& out, std::string_view str);
+
+}  // namespace bits::ttl
@@ -0,0 +1,38 @@
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include "deferred_log.hpp"
+
+using namespace bits::ttl;
+
+// Formats a binary log written by DeferredLogOptions::path.
+//
+//   log_decode <path>
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <path>\n";
+    return 2;
+  }
+
+  try {
+    std::ifstream in(argv[1], std::ios::binary);
+    if (!in) {
+      std::cerr << "log_decode: cannot open " << argv[1] << "\n";
+      return 1;
+    }
+    const std::string log{std::istreambuf_iterator<char>(in),
+                          std::istreambuf_iterator<char>()};
+    std::string out;
+    const bool ok = deferred::decode(log, out);
+    std::cout << out;
+    if (!ok) {
+      std::cerr << "log_decode: " << argv[1] << " is truncated or malformed\n";
+      return 1;
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "log_decode: " << e.what() << "\n";
+    return 1;
+  }
+}
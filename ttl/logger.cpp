@@ -1,48 +1,397 @@
 #include "logger.hpp"
 #include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
 #include "runtime.hpp"
-#include "sink.hpp"
+#include "symbols.hpp"
 #include "types.hpp"
 
 using std::chrono::steady_clock;
 
 namespace bits::ttl {
 
+struct LogModules {
+  std::mutex mutex;
+  std::map<std::string, std::unique_ptr<LogModule>, std::less<>> modules;
+
+  static LogModules& instance() {
+    static LogModules* modules = new LogModules();
+    return *modules;
+  }
+
+  LogModule& get(std::string_view name) {
+    if (auto it = modules.find(name); it != modules.end()) {
+      return *it->second;
+    }
+    LogModule* parent = nullptr;
+    if (!name.empty()) {
+      const auto dot = name.rfind('.');
+      parent = &get(dot == std::string_view::npos ? std::string_view{}
+                                                  : name.substr(0, dot));
+    }
+    auto& module = *modules
+                        .emplace(std::string(name),
+                                 std::make_unique<LogModule>(std::string(name),
+                                                             parent))
+                        .first->second;
+    module.level_.store(parent != nullptr ? parent->level_.load() : 0,
+                        std::memory_order_relaxed);
+    return module;
+  }
+
+  void set(std::string_view name, std::optional<LogLevel> level) {
+    get(name).own_ = level;
+    // The map is ordered, so every parent is updated before its children.
+    for (auto& [_, module] : modules) {
+      uint8_t effective = 0;
+      if (module->own_) {
+        effective = static_cast<uint8_t>(*module->own_);
+      } else if (module->parent_ != nullptr) {
+        effective = module->parent_->level_.load(std::memory_order_relaxed);
+      }
+      module->level_.store(effective, std::memory_order_relaxed);
+    }
+    detail::log_levels_generation.fetch_add(1, std::memory_order_release);
+  }
+};
+
+LogModule::LogModule(std::string name, LogModule* parent)
+    : name_(std::move(name)), parent_(parent) {}
+
+LogModule& logModule(std::string_view name) {
+  auto& modules = LogModules::instance();
+  std::unique_lock lock(modules.mutex);
+  return modules.get(name);
+}
+
+void setLogLevel(std::string_view module, LogLevel level) {
+  auto& modules = LogModules::instance();
+  std::unique_lock lock(modules.mutex);
+  modules.set(module, level);
+}
+
+void clearLogLevel(std::string_view module) {
+  auto& modules = LogModules::instance();
+  std::unique_lock lock(modules.mutex);
+  modules.set(module, std::nullopt);
+}
+
+void setLogLevels(std::string_view spec) {
+  while (!spec.empty()) {
+    const auto comma = spec.find(',');
+    const auto item  = spec.substr(0, comma);
+    spec = comma == std::string_view::npos ? std::string_view{}
+                                           : spec.substr(comma + 1);
+    if (item.empty()) {
+      continue;
+    }
+
+    const auto eq = item.find('=');
+    const auto module =
+        eq == std::string_view::npos ? std::string_view{} : item.substr(0, eq);
+    const auto name =
+        eq == std::string_view::npos ? item : item.substr(eq + 1);
+    std::optional<LogLevel> level;
+    for (uint8_t l = 0; l <= static_cast<uint8_t>(LogLevel::Critical); ++l) {
+      if (logLevelName(static_cast<LogLevel>(l)) == name) {
+        level = static_cast<LogLevel>(l);
+      }
+    }
+    if (!level) {
+      throw std::invalid_argument(
+          std::format("ttl: unknown log level '{}' for module '{}'", name,
+                      module));
+    }
+    setLogLevel(module, *level);
+  }
+}
+
+bool LogGate::refresh(LogLevel level) noexcept {
+  const uint32_t generation =
+      detail::log_levels_generation.load(std::memory_order_acquire);
+  const LogModule* module = module_.load(std::memory_order_relaxed);
+  if (module == nullptr) {
+    module = &logModule(name_);
+    module_.store(module, std::memory_order_relaxed);
+  }
+  const bool on = module->enabled(level);
+  state_.store(generation << 1 | static_cast<uint32_t>(on),
+               std::memory_order_release);
+  return on;
+}
+
+namespace {
+constexpr size_t kEntryHeader =
+    1 + sizeof(int64_t) + sizeof(LogModule*) + sizeof(uint32_t);
+
+size_t fieldSize(const LogField& field) {
+  const size_t value = field.kind == Kind::String
+                           ? sizeof(uint32_t) + field.s.size()
+                           : sizeof(int64_t);
+  return sizeof(Symbol) + 1 + value;
+}
+
+std::byte* put(std::byte* p, const void* src, size_t n) {
+  std::memcpy(p, src, n);
+  return p + n;
+}
+
+template <typename T>
+bool get(std::span<const std::byte>& in, T& value) {
+  if (in.size() < sizeof(T)) {
+    return false;
+  }
+  std::memcpy(&value, in.data(), sizeof(T));
+  in = in.subspan(sizeof(T));
+  return true;
+}
+// Entries taken from one ring before moving on to the next.
+constexpr size_t kTurn = 64;
+}  // namespace
+
 namespace detail {
-LoggerImpl::LoggerImpl(std::string name) : name_(std::move(name)) {}
+LoggerImpl::LoggerImpl(std::string name)
+    : LoggerImpl(std::move(name), LoggerOptions{}) {}
 
-void LoggerImpl::yield(LogLevel level, const std::string& message) {
-  Event event{
-      .type      = "log",
-      .name      = name_,
-      .timestamp = steady_clock::now().time_since_epoch(),
-      .fields    = {Field{.key = "level", .value = logLevelToString(level)},
-                    Field{.key = "message", .value = message}}};
+LoggerImpl::LoggerImpl(std::string name, LoggerOptions options)
+    : name_(std::move(name)),
+      options_(options),
+      symbol_(intern(name_)),
+      type_(intern("log")),
+      level_key_(intern("level")),
+      message_key_(intern("message")),
+      module_key_(intern("module")),
+      repeat_key_(intern("repeat")) {}
 
-  q_.push(std::move(event));
+void LoggerImpl::yield(const LogModule& module, LogLevel level,
+                       std::string_view message,
+                       std::initializer_list<LogField> fields) {
+  auto& ring = rings_.local();
+  if (!ring.ready()) [[unlikely]] {
+    ring.init(options_.buffer);
+  }
+
+  size_t size = kEntryHeader + message.size();
+  for (const auto& field : fields) {
+    size += fieldSize(field);
+  }
+  if (size > ring.maxRecord()) [[unlikely]] {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  std::byte* p = ring.reserve(size);
+  while (p == nullptr) {
+    switch (options_.drop) {
+      case DropPolicy::Newest:
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+      case DropPolicy::Oldest:
+        if (ring.evict()) {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+        break;
+      case DropPolicy::Block:
+        std::this_thread::yield();
+        break;
+    }
+    // Once seen empty the ring stays so until this thread commits, and an
+    // empty ring takes any record within maxRecord(). The consumer may
+    // drain it between checks, so only a failure after that is final.
+    const bool empty = ring.used() == 0;
+    p                = ring.reserve(size);
+    if (p == nullptr && empty) [[unlikely]] {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+  }
+
+  const int64_t ts    = steady_clock::now().time_since_epoch().count();
+  const auto* source  = &module;
+  const auto length   = static_cast<uint32_t>(message.size());
+  *p++                = static_cast<std::byte>(level);
+  p                   = put(p, &ts, sizeof(ts));
+  p                   = put(p, &source, sizeof(source));
+  p                   = put(p, &length, sizeof(length));
+  p                   = put(p, message.data(), message.size());
+  for (const auto& field : fields) {
+    p    = put(p, &field.key, sizeof(field.key));
+    *p++ = static_cast<std::byte>(field.kind);
+    switch (field.kind) {
+      case Kind::Int:
+        p = put(p, &field.i, sizeof(field.i));
+        break;
+      case Kind::Double:
+        p = put(p, &field.d, sizeof(field.d));
+        break;
+      case Kind::String: {
+        const auto len = static_cast<uint32_t>(field.s.size());
+        p              = put(p, &len, sizeof(len));
+        p              = put(p, field.s.data(), field.s.size());
+        break;
+      }
+    }
+  }
+  ring.commit(size);
 }
 
-void LoggerImpl::capture(ISink& sink) {
-  while (auto event = q_.tryTake()) {
-    sink.publish(std::move(*event));
+void LoggerImpl::add(Arena& arena, std::span<const std::byte> entry) {
+  if (!options_.coalesce) {
+    emit(arena, entry, 1);
+    return;
   }
+
+  // Everything but the timestamp has to match.
+  const auto pending = std::as_bytes(std::span(pending_));
+  if (repeat_ != 0 && pending.size() == entry.size() && pending[0] == entry[0] &&
+      std::memcmp(pending.data() + 1 + sizeof(int64_t),
+                  entry.data() + 1 + sizeof(int64_t),
+                  entry.size() - 1 - sizeof(int64_t)) == 0) {
+    ++repeat_;
+    return;
+  }
+
+  flushRepeats(arena);
+  pending_.assign(reinterpret_cast<const char*>(entry.data()), entry.size());
+  repeat_ = 1;
+}
+
+void LoggerImpl::flushRepeats(Arena& arena) {
+  if (repeat_ != 0) {
+    emit(arena, std::as_bytes(std::span(pending_)), repeat_);
+    repeat_ = 0;
+  }
+}
+
+// Stamped with the first occurrence of a repeated entry.
+void LoggerImpl::emit(Arena& arena, std::span<const std::byte> entry,
+                      uint64_t repeat) {
+  uint8_t level           = 0;
+  int64_t ts              = 0;
+  const LogModule* module = nullptr;
+  uint32_t length         = 0;
+  get(entry, level);
+  get(entry, ts);
+  get(entry, module);
+  get(entry, length);
+
+  arena.begin(type_, symbol_, std::chrono::nanoseconds(ts));
+  arena.add(level_key_, logLevelName(static_cast<LogLevel>(level)));
+  arena.add(message_key_,
+            std::string_view(reinterpret_cast<const char*>(entry.data()),
+                             length));
+  entry = entry.subspan(length);
+  if (!module->name().empty()) {
+    arena.add(module_key_, module->name());
+  }
+  if (repeat > 1) {
+    arena.add(repeat_key_, static_cast<int64_t>(repeat));
+  }
+
+  Symbol key   = 0;
+  uint8_t kind = 0;
+  while (get(entry, key) && get(entry, kind)) {
+    switch (static_cast<Kind>(kind)) {
+      case Kind::Int: {
+        int64_t value = 0;
+        get(entry, value);
+        arena.add(key, value);
+        break;
+      }
+      case Kind::Double: {
+        double value = 0;
+        get(entry, value);
+        arena.add(key, value);
+        break;
+      }
+      case Kind::String: {
+        uint32_t len = 0;
+        get(entry, len);
+        arena.add(key, std::string_view(
+                           reinterpret_cast<const char*>(entry.data()), len));
+        entry = entry.subspan(len);
+        break;
+      }
+    }
+  }
+}
+
+void LoggerImpl::capture(Arena& arena) {
+  // Takes up to `limit` entries from `ring`; true if it stopped at the
+  // limit rather than on an empty ring.
+  const auto drain = [&](bits::SPSCByteRing& ring, size_t limit) {
+    size_t n = 0;
+    if (options_.drop == DropPolicy::Oldest) {
+      for (; n < limit && ring.take(entry_); ++n) {
+        add(arena, std::as_bytes(std::span(entry_)));
+      }
+      return n == limit;
+    }
+    for (auto entry = ring.front(); !entry.empty(); entry = ring.front()) {
+      if (n++ == limit) {
+        break;
+      }
+      add(arena, entry);
+      ring.pop(entry);
+    }
+    ring.release();
+    return n > limit;
+  };
+
+  // Rings are visited round-robin, kTurn entries at a time, so one busy
+  // thread cannot crowd the others out of a capture. The number of
+  // rounds is bounded by what a full ring holds, which also keeps
+  // capture() finite while threads keep logging.
+  const size_t rounds = options_.buffer / (kEntryHeader + 4) / kTurn + 1;
+  bool more           = true;
+  for (size_t round = 0; more && round < rounds; ++round) {
+    more = false;
+    rings_.forEach([&](bits::SPSCByteRing& ring, bool orphaned) {
+      if (!ring.ready()) {
+        return;
+      }
+      // An orphaned ring is dropped after this visit.
+      more = drain(ring, orphaned ? SIZE_MAX : kTurn) || more;
+    });
+  }
+  flushRepeats(arena);
 }
 }  // namespace detail
 
 Logger& Logger::instance() {
   static auto impl =
       detail::Runtime::instance()->makeObject<detail::LoggerImpl>("logger");
-  static Logger logger{impl};
+  static Logger logger{impl, logModule("")};
   return logger;
 }
 
 Logger::Logger() : Logger(detail::Runtime::instance()) {};
 
-Logger::Logger(const std::shared_ptr<detail::Runtime>& runtime)
-    : impl_(runtime->makeObject<detail::LoggerImpl>("logger")) {}
+Logger::Logger(const std::shared_ptr<detail::Runtime>& runtime,
+               LoggerOptions options)
+    : impl_(runtime->makeObject<detail::LoggerImpl>("logger", std::move(options))),
+      module_(&logModule("")) {}
+
+Logger Logger::named(std::string_view module) const {
+  return Logger{impl_, logModule(module)};
+}
+
+void Logger::log(LogLevel level, std::string_view message,
+                 std::initializer_list<LogField> fields) {
+  if (module_->enabled(level)) {
+    impl_->yield(*module_, level, message, fields);
+  }
+}
 
-void Logger::log(LogLevel level, const std::string& message) {
-  impl_->yield(level, message);
+void Logger::log(const LogModule& module, LogLevel level,
+                 std::string_view message,
+                 std::initializer_list<LogField> fields) {
+  impl_->yield(module, level, message, fields);
 }
 
 }  // namespace bits::ttl
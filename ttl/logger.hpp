@@ -1,10 +1,20 @@
 #pragma once
 
+#include <bits/spsc_ring.hpp>
+#include <bits/thread_slots.hpp>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <algorithm>
+#include <concepts>
 #include <cstdint>
+#include <initializer_list>
 #include <memory>
-#include <bits/queue.hpp>
+#include <optional>
 #include <sstream>
 #include <string>
+#include <string_view>
+#include "symbols.hpp"
 #include "telemetry_object.hpp"
 #include "types.hpp"
 
@@ -19,7 +29,7 @@ enum class LogLevel : uint8_t {
   Critical = 5,
 };
 
-inline std::string logLevelToString(LogLevel level) {
+constexpr std::string_view logLevelName(LogLevel level) {
   switch (level) {
     case LogLevel::Trace:
       return "Trace";
@@ -34,19 +44,201 @@ inline std::string logLevelToString(LogLevel level) {
     case LogLevel::Critical:
       return "Critical";
   }
+  return "Unknown";
+}
+
+inline std::string logLevelToString(LogLevel level) {
+  return std::string(logLevelName(level));
 }
 
 class ISink;
 
+// A named log module. Names are hierarchical, "net.http" inherits the
+// level of "net", which inherits the root "". Modules live for the whole
+// process, so references to them never dangle.
+class LogModule {
+ public:
+  LogModule(std::string name, LogModule* parent);
+
+  [[nodiscard]] std::string_view name() const noexcept { return name_; }
+  [[nodiscard]] LogModule* parent() const noexcept { return parent_; }
+
+  // Effective level: the module's own, or its nearest ancestor's.
+  [[nodiscard]] LogLevel level() const noexcept {
+    return static_cast<LogLevel>(level_.load(std::memory_order_relaxed));
+  }
+  [[nodiscard]] bool enabled(LogLevel level) const noexcept {
+    return level >= this->level();
+  }
+
+ private:
+  friend struct LogModules;
+
+  std::string name_;
+  LogModule* parent_;
+  std::atomic<uint8_t> level_{0};
+  // Set by setLogLevel(), guarded by the module table's mutex.
+  std::optional<LogLevel> own_;
+};
+
+// The module called `name`, created (with its ancestors) on first use.
+LogModule& logModule(std::string_view name);
+
+// Sets the level of `module` and of every descendant without a level of
+// its own. Everything is enabled (Trace) until set.
+void setLogLevel(std::string_view module, LogLevel level);
+// Makes `module` inherit its parent's level again.
+void clearLogLevel(std::string_view module);
+// Applies a comma-separated list of `module=level` (a bare `level` sets
+// the root), e.g. "Info,net=Debug,net.tls=Warn". Throws
+// std::invalid_argument on unknown level names.
+void setLogLevels(std::string_view spec);
+
+namespace detail {
+// Bumped by every level change; LogGate caches are valid for one value.
+inline std::atomic<uint32_t> log_levels_generation{0};
+}  // namespace detail
+
+// Per-call-site cache of "is this site's level enabled for its module".
+// The enabled check is two relaxed loads and a compare; the module's
+// level is only consulted again after a level change somewhere.
+class LogGate {
+ public:
+  constexpr explicit LogGate(std::string_view module) : name_(module) {}
+
+  [[nodiscard]] bool enabled(LogLevel level) noexcept {
+    const uint32_t generation =
+        detail::log_levels_generation.load(std::memory_order_relaxed);
+    const uint32_t state = state_.load(std::memory_order_acquire);
+    if ((state >> 1) == generation) [[likely]] {
+      return (state & 1) != 0;
+    }
+    return refresh(level);
+  }
+
+  // Valid once enabled() has returned true.
+  [[nodiscard]] const LogModule& module() const noexcept {
+    return *module_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  bool refresh(LogLevel level) noexcept;
+
+  std::string_view name_;
+  // Written on the slow path; racing refreshes store the same value.
+  std::atomic<const LogModule*> module_{nullptr};
+  // generation << 1 | enabled; the initial value matches no generation
+  // in practice.
+  std::atomic<uint32_t> state_{UINT32_MAX};
+};
+
+// A field key spelled as a template argument: kv<"user">(id).
+template <size_t N>
+struct LogKey {
+  // NOLINTNEXTLINE(google-explicit-constructor)
+  constexpr LogKey(const char (&str)[N]) { std::copy_n(str, N, name); }
+
+  [[nodiscard]] constexpr std::string_view view() const noexcept {
+    return {name, N - 1};
+  }
+
+  char name[N]{};
+};
+
+// A typed key/value attached to a log record as a regular field.
+// String values are copied into the log ring, so they only need to
+// outlive the log call.
+struct LogField {
+  Symbol key;
+  Kind kind;
+  int64_t i{0};
+  double d{0};
+  std::string_view s;
+};
+
+// Interned once per key, on first use.
+template <LogKey Key>
+Symbol logKey() {
+  static const Symbol symbol = intern(Key.view());
+  return symbol;
+}
+
+template <LogKey Key, typename T>
+LogField kv(const T& value) {
+  if constexpr (std::is_convertible_v<const T&, std::string_view>) {
+    return {.key  = logKey<Key>(),
+            .kind = Kind::String,
+            .i    = 0,
+            .d    = 0,
+            .s    = value};
+  } else if constexpr (std::is_floating_point_v<T>) {
+    return {.key  = logKey<Key>(),
+            .kind = Kind::Double,
+            .i    = 0,
+            .d    = static_cast<double>(value),
+            .s    = {}};
+  } else {
+    static_assert(std::is_integral_v<T> || std::is_enum_v<T>,
+                  "kv() takes numbers and strings");
+    return {.key  = logKey<Key>(),
+            .kind = Kind::Int,
+            .i    = static_cast<int64_t>(value),
+            .d    = 0,
+            .s    = {}};
+  }
+}
+
+struct LoggerOptions {
+  // Bytes of each thread's ring, allocated on its first log call. An
+  // entry takes 21 bytes plus the message, its fields and a 4-byte frame
+  // header.
+  size_t buffer = 64 << 10;
+  // Block waits for the next capture, so only use it with a running
+  // runtime.
+  DropPolicy drop = DropPolicy::Newest;
+  // Merge runs of identical entries (same module, level and message)
+  // drained in one capture into a single record with a "repeat" count.
+  bool coalesce = true;
+};
+
 namespace detail {
 class Runtime;
 
+// Each logging thread writes
+//   u8 level | i64 timestamp (ns) | LogModule* | u32 len | message |
+//   fields: u32 key | u8 kind | i64, f64 or u32 len + bytes
+// into its own bounded SPSC ring; capture() drains the rings in turn.
 struct LoggerImpl : public ITelemetryObject {
   explicit LoggerImpl(std::string name);
-  void yield(LogLevel level, const std::string& message);
-  void capture(ISink& sink) override;
-  bits::MPSCQueue<Event> q_;
+  LoggerImpl(std::string name, LoggerOptions options);
+  void yield(const LogModule& module, LogLevel level,
+             std::string_view message,
+             std::initializer_list<LogField> fields = {});
+  void capture(Arena& arena) override;
+
+  [[nodiscard]] size_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+  void add(Arena& arena, std::span<const std::byte> entry);
+  void flushRepeats(Arena& arena);
+  void emit(Arena& arena, std::span<const std::byte> entry, uint64_t repeat);
+
   std::string name_;
+  LoggerOptions options_;
+  bits::ThreadSlots<bits::SPSCByteRing> rings_;
+  std::atomic<size_t> dropped_{0};
+  Symbol symbol_;
+  Symbol type_;
+  Symbol level_key_;
+  Symbol message_key_;
+  Symbol module_key_;
+  Symbol repeat_key_;
+  // Flush thread only; entries copied out of lossy rings, and the entry
+  // being coalesced with how often it was seen.
+  std::string entry_;
+  std::string pending_;
+  uint64_t repeat_{0};
 };
 
 }  // namespace detail
@@ -55,22 +247,56 @@ class Logger {
  public:
   static Logger& instance();
   explicit Logger();
-  explicit Logger(const std::shared_ptr<detail::Runtime>& runtime);
+  explicit Logger(const std::shared_ptr<detail::Runtime>& runtime,
+                  LoggerOptions options = {});
 
-  void log(LogLevel level, const std::string& message);
+  // The same logger writing as `module` (see LogModule).
+  [[nodiscard]] Logger named(std::string_view module) const;
+  [[nodiscard]] const LogModule& module() const noexcept { return *module_; }
+
+  [[nodiscard]] bool enabled(LogLevel level) const noexcept {
+    return module_->enabled(level);
+  }
+
+  // logger.log(Info, "login", {kv<"user">(id), kv<"ms">(elapsed)});
+  // Fields reach sinks as typed record fields, nothing is stringified.
+  void log(LogLevel level, std::string_view message,
+           std::initializer_list<LogField> fields = {});
+  // Logs as `module` without checking its level.
+  void log(const LogModule& module, LogLevel level, std::string_view message,
+           std::initializer_list<LogField> fields = {});
+
+  // Entries lost to full rings: rejected (Newest), evicted (Oldest) or
+  // larger than a ring.
+  [[nodiscard]] size_t dropped() const noexcept { return impl_->dropped(); }
 
  private:
-  explicit Logger(std::shared_ptr<detail::LoggerImpl> impl)
-      : impl_(std::move(impl)) {}
+  Logger(std::shared_ptr<detail::LoggerImpl> impl, const LogModule& module)
+      : impl_(std::move(impl)), module_(&module) {}
 
   std::shared_ptr<detail::LoggerImpl> impl_;
+  const LogModule* module_;
 };
 
+// Formats a message and logs it on destruction. Nothing is formatted
+// when the logger's module has `level` disabled.
 class LogStream {
  public:
-  LogStream(Logger& logger, LogLevel level) : logger_(logger), level_(level) {}
+  LogStream(Logger& logger, LogLevel level)
+      : LogStream(logger, level, logger.module()) {}
+  // Logs as `module` rather than the logger's own, see TTL_LOGM.
+  LogStream(Logger& logger, LogLevel level, const LogModule& module)
+      : logger_(logger), level_(level), module_(module) {
+    if (module.enabled(level)) {
+      stream_.emplace();
+    }
+  }
 
-  ~LogStream() { logger_.log(level_, stream_.str()); }
+  ~LogStream() {
+    if (stream_) {
+      logger_.log(module_, level_, stream_->str());
+    }
+  }
 
   LogStream(const LogStream&)            = delete;
   LogStream& operator=(const LogStream&) = delete;
@@ -79,14 +305,17 @@ class LogStream {
 
   template <typename T>
   LogStream& operator<<(const T& value) {
-    stream_ << value;
+    if (stream_) {
+      *stream_ << value;
+    }
     return *this;
   }
 
  private:
   Logger& logger_;
   LogLevel level_;
-  std::ostringstream stream_;
+  const LogModule& module_;
+  std::optional<std::ostringstream> stream_;
 };
 
 #ifndef TTL_LOG_MIN_LEVEL
@@ -95,9 +324,90 @@ class LogStream {
 
 #define TTL_LOG_ENABLED(level) (static_cast<int>(level) >= TTL_LOG_MIN_LEVEL)
 
-#define TTL_LOG(level)                  \
-  if constexpr (TTL_LOG_ENABLED(level)) \
-  ::bits::ttl::LogStream(::bits::ttl::Logger::instance(), level)
+// TTL_LOGM("net.http", Debug) << "sent " << n;
+// `name` must be a string literal. A site whose level is disabled for
+// its module costs one well-predicted branch and formats nothing.
+#define TTL_LOGM(name, level)                                            \
+  if constexpr (TTL_LOG_ENABLED(level))                                  \
+    if (static constinit ::bits::ttl::LogGate ttl_log_gate_{name};       \
+        ttl_log_gate_.enabled(level))                                    \
+  ::bits::ttl::LogStream(::bits::ttl::Logger::instance(), level,         \
+                         ttl_log_gate_.module())
+
+#define TTL_LOG(level) TTL_LOGM("", level)
+
+// TTL_LOGKV(Info, "login", kv<"user">(id), kv<"ms">(elapsed));
+// Structured logging without a LogStream: the message is taken as is and
+// each kv() becomes a record field.
+#define TTL_LOGMKV(name, level, message, ...)                             \
+  do {                                                                    \
+    if constexpr (TTL_LOG_ENABLED(level)) {                               \
+      static constinit ::bits::ttl::LogGate ttl_log_gate_{name};          \
+      if (ttl_log_gate_.enabled(level)) {                                 \
+        ::bits::ttl::Logger::instance().log(ttl_log_gate_.module(), level, \
+                                            message, {__VA_ARGS__});      \
+      }                                                                   \
+    }                                                                     \
+  } while (false)
+
+#define TTL_LOGKV(level, message, ...) \
+  TTL_LOGMKV("", level, message __VA_OPT__(, ) __VA_ARGS__)
+
+// Per-call-site rate limits. Both are decided with one relaxed atomic
+// operation, after the level check and before any formatting.
+class LogEveryN {
+ public:
+  // n == 0 behaves like n == 1: every call passes.
+  [[nodiscard]] bool operator()(uint64_t n) noexcept {
+    const uint64_t count = count_.fetch_add(1, std::memory_order_relaxed);
+    return n <= 1 || count % n == 0;
+  }
+
+ private:
+  std::atomic<uint64_t> count_{0};
+};
+
+class LogEvery {
+ public:
+  [[nodiscard]] bool operator()(std::chrono::nanoseconds interval) noexcept {
+    const int64_t now =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    int64_t next = next_.load(std::memory_order_relaxed);
+    // Of the threads racing for a slot, the CAS lets exactly one through.
+    return now >= next &&
+           next_.compare_exchange_strong(next, now + interval.count(),
+                                         std::memory_order_relaxed);
+  }
+
+ private:
+  std::atomic<int64_t> next_{INT64_MIN};
+};
+
+// TTL_LOGM_EVERY_N("net", Warn, 1000) << "slow peer " << peer;
+// Logs the 1st, (n+1)th, (2n+1)th... call of the site; n == 0 logs every
+// call.
+#define TTL_LOGM_EVERY_N(name, level, n)                                    \
+  if constexpr (TTL_LOG_ENABLED(level))                                     \
+    if (static constinit ::bits::ttl::LogGate ttl_log_gate_{name};          \
+        ttl_log_gate_.enabled(level))                                       \
+      if (static constinit ::bits::ttl::LogEveryN ttl_log_every_;           \
+          ttl_log_every_(n))                                                \
+  ::bits::ttl::LogStream(::bits::ttl::Logger::instance(), level,            \
+                         ttl_log_gate_.module())
+
+// TTL_LOGM_EVERY("db", Error, std::chrono::seconds(1)) << "pool exhausted";
+// Logs at most once per interval.
+#define TTL_LOGM_EVERY(name, level, interval)                               \
+  if constexpr (TTL_LOG_ENABLED(level))                                     \
+    if (static constinit ::bits::ttl::LogGate ttl_log_gate_{name};          \
+        ttl_log_gate_.enabled(level))                                       \
+      if (static constinit ::bits::ttl::LogEvery ttl_log_every_;            \
+          ttl_log_every_(interval))                                         \
+  ::bits::ttl::LogStream(::bits::ttl::Logger::instance(), level,            \
+                         ttl_log_gate_.module())
+
+#define TTL_LOG_EVERY_N(level, n) TTL_LOGM_EVERY_N("", level, n)
+#define TTL_LOG_EVERY(level, interval) TTL_LOGM_EVERY("", level, interval)
 
 constexpr auto Trace    = LogLevel::Trace;
 constexpr auto Debug    = LogLevel::Debug;
@@ -0,0 +1,436 @@
+#include "prometheus_sink.hpp"
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <util.hpp>
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+// epoll data for the listening socket and the wake pipe; connections use
+// their index in `conns_`.
+constexpr uint64_t kListen = ~uint64_t{0};
+constexpr uint64_t kWake   = ~uint64_t{0} - 1;
+
+constexpr std::string_view kNotFound =
+    "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+constexpr std::string_view kBadRequest =
+    "HTTP/1.1 400 Bad Request\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+
+// Metric names are [a-zA-Z_:][a-zA-Z0-9_:]*.
+std::string metricName(std::string_view name) {
+  std::string out;
+  out.reserve(name.size() + 1);
+  if (name.empty() || (name[0] >= '0' && name[0] <= '9')) {
+    out.push_back('_');
+  }
+  for (const char c : name) {
+    const bool ok = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                    (c >= '0' && c <= '9') || c == '_' || c == ':';
+    out.push_back(ok ? c : '_');
+  }
+  return out;
+}
+
+void appendNumber(std::string& out, double v) {
+  if (std::isnan(v)) {
+    out.append("NaN");
+    return;
+  }
+  if (std::isinf(v)) {
+    out.append(v > 0 ? "+Inf" : "-Inf");
+    return;
+  }
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  if (ec == std::errc()) {
+    out.append(buf, ptr);
+  }
+}
+
+void appendFamily(std::string& out, std::string_view name,
+                  std::string_view suffix, std::string_view type) {
+  out.append("# TYPE ");
+  out.append(name);
+  out.append(suffix);
+  out.push_back(' ');
+  out.append(type);
+  out.push_back('\n');
+}
+
+// "p99.9" -> "0.999"; empty when `key` is not a quantile.
+std::string quantileLabel(std::string_view key) {
+  if (key.size() < 2 || key[0] != 'p') {
+    return {};
+  }
+  double percent = 0;
+  const auto& rc = std::from_chars(key.data() + 1, key.data() + key.size(),
+                                   percent);
+  if (rc.ec != std::errc{} || rc.ptr != key.data() + key.size()) {
+    return {};
+  }
+  // Rounded like the key itself, 99.9 / 100 is 0.9990000000000001.
+  return std::format("{:.10g}", percent / 100);
+}
+}  // namespace
+
+PrometheusSink::PrometheusSink(std::string_view address,
+                               PrometheusOptions options)
+    : options_(options),
+      conns_(std::max<size_t>(options.connections, 1)),
+      summary_(intern("summary")),
+      log_(intern("log")),
+      value_(intern("value")),
+      count_(intern("count")),
+      sum_(intern("sum")) {
+  const auto& parsed = parseAddress(address);
+  if (!parsed) {
+    throw std::invalid_argument(std::format("invalid address: {}", address));
+  }
+
+  listen_ = makeSockTcp();
+  if (listen_ < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "ttl: failed to create socket");
+  }
+  setSockOptShared(listen_);
+  setSockOptNonBlocking(listen_);
+  if (sockBind(listen_, parsed->second, parsed->first) != 0 ||
+      sockListen(listen_) != 0) {
+    const int err = errno;
+    ::close(listen_);
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: failed to listen on {}", address));
+  }
+  address_ = getSockOptHostPort(listen_).value_or(std::string(address));
+
+  pipe_  = makePipe();
+  epoll_ = makeEpoll();
+  epoll_event ev{.events = EPOLLIN, .data = {.u64 = kListen}};
+  ::epoll_ctl(epoll_, EPOLL_CTL_ADD, listen_, &ev);
+  ev.data.u64 = kWake;
+  ::epoll_ctl(epoll_, EPOLL_CTL_ADD, pipe_[0], &ev);
+
+  thread_ = std::jthread([this](const std::stop_token& token) { run(token); });
+}
+
+PrometheusSink::~PrometheusSink() {
+  thread_.request_stop();
+  wake();
+  thread_.join();
+  for (auto& conn : conns_) {
+    close(conn);
+  }
+  ::close(listen_);
+  ::close(epoll_);
+  ::close(pipe_[0]);
+  ::close(pipe_[1]);
+}
+
+void PrometheusSink::publish(Event&& event) {
+  publishBatch(Arena::fromEvent(event));
+}
+
+void PrometheusSink::publish(const Record& record, const Arena& arena) {
+  std::unique_lock lock(mutex_);
+  update(record, arena);
+}
+
+void PrometheusSink::publishBatch(const Arena& arena) {
+  if (arena.empty()) {
+    return;
+  }
+  std::unique_lock lock(mutex_);
+  for (const auto& record : arena.records()) {
+    update(record, arena);
+  }
+}
+
+void PrometheusSink::update(const Record& record, const Arena& arena) {
+  if (record.type == log_) {
+    return;
+  }
+
+  auto it = index_.find(record.name);
+  if (it == index_.end()) {
+    it = index_.emplace(record.name, series_.size()).first;
+    series_.push_back({.name    = metricName(lookup(record.name)),
+                       .summary = record.type == summary_,
+                       .values  = {}});
+  }
+
+  auto& series = series_[it->second];
+  for (const auto& f : arena.fields(record)) {
+    if (f.kind == Kind::String) {
+      continue;
+    }
+    const double v = f.kind == Kind::Int ? static_cast<double>(f.i) : f.d;
+    // Summary count and sum cover one capture window; Prometheus wants
+    // them cumulative.
+    if (series.summary && (f.key == count_ || f.key == sum_)) {
+      slot(series, f.key).v += v;
+    } else {
+      slot(series, f.key).v = v;
+    }
+  }
+}
+
+PrometheusSink::Value& PrometheusSink::slot(Series& series, Symbol key) {
+  for (auto& value : series.values) {
+    if (value.key == key) {
+      return value;
+    }
+  }
+
+  Value value{.key = key, .label = {}, .quantile = false, .v = 0};
+  const auto& name = lookup(key);
+  if (series.summary) {
+    value.label    = quantileLabel(name);
+    value.quantile = !value.label.empty();
+  }
+  if (!value.quantile && !(key == value_ && !series.summary)) {
+    value.label = metricName("_" + std::string(name));
+  }
+  return series.values.emplace_back(std::move(value));
+}
+
+void PrometheusSink::render() {
+  page_.clear();
+  {
+    std::unique_lock lock(mutex_);
+    for (const auto& series : series_) {
+      const auto& name = series.name;
+      if (series.summary) {
+        appendFamily(page_, name, "", "summary");
+        for (const auto& value : series.values) {
+          if (value.quantile) {
+            page_.append(name);
+            page_.append("{quantile=\"");
+            page_.append(value.label);
+            page_.append("\"} ");
+            appendNumber(page_, value.v);
+            page_.push_back('\n');
+          }
+        }
+        for (const auto& value : series.values) {
+          if (value.key == sum_ || value.key == count_) {
+            page_.append(name);
+            page_.append(value.label);
+            page_.push_back(' ');
+            appendNumber(page_, value.v);
+            page_.push_back('\n');
+          }
+        }
+      }
+
+      for (const auto& value : series.values) {
+        if (value.quantile ||
+            (series.summary && (value.key == sum_ || value.key == count_))) {
+          continue;
+        }
+        appendFamily(page_, name, value.label, "gauge");
+        page_.append(name);
+        page_.append(value.label);
+        page_.push_back(' ');
+        appendNumber(page_, value.v);
+        page_.push_back('\n');
+      }
+    }
+  }
+
+  head_.clear();
+  head_.append(
+      "HTTP/1.1 200 OK\r\n"
+      "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+      "Connection: close\r\n"
+      "Content-Length: ");
+  char buf[24];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), page_.size());
+  head_.append(buf, ptr);
+  head_.append("\r\n\r\n");
+
+  rendered_    = true;
+  rendered_at_ = std::chrono::steady_clock::now();
+  renders_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void PrometheusSink::wake() const noexcept {
+  const char c = 0;
+  // The write end is non-blocking; EAGAIN means the pipe is full, which
+  // already guarantees a wakeup.
+  [[maybe_unused]] const auto n = ::write(pipe_[1], &c, 1);
+}
+
+void PrometheusSink::run(const std::stop_token& token) {
+  std::array<epoll_event, 16> events{};
+  while (!token.stop_requested()) {
+    const int n = ::epoll_wait(epoll_, events.data(),
+                               static_cast<int>(events.size()), -1);
+    for (int i = 0; i < n; ++i) {
+      const auto& ev = events[static_cast<size_t>(i)];
+      if (ev.data.u64 == kWake) {
+        char buf[256];
+        while (::read(pipe_[0], buf, sizeof(buf)) > 0) {
+        }
+        continue;
+      }
+      if (ev.data.u64 == kListen) {
+        accept();
+        continue;
+      }
+
+      auto& conn = conns_[ev.data.u64];
+      if (conn.fd < 0) {
+        continue;
+      }
+      if ((ev.events & (EPOLLERR | EPOLLHUP)) != 0) {
+        close(conn);
+        continue;
+      }
+      if (conn.head.empty()) {
+        receive(conn);
+      } else {
+        respond(conn);
+      }
+    }
+  }
+}
+
+void PrometheusSink::accept() {
+  while (true) {
+    const int fd =
+        ::accept4(listen_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      return;
+    }
+
+    const auto& it = std::ranges::find_if(
+        conns_, [](const Conn& conn) { return conn.fd < 0; });
+    if (it == conns_.end()) {
+      ::close(fd);
+      continue;
+    }
+
+    *it = Conn{.fd   = fd,
+               .in   = {},
+               .len  = 0,
+               .head = {},
+               .page = false,
+               .sent = 0};
+    epoll_event ev{.events = EPOLLIN | EPOLLRDHUP,
+                   .data   = {.u64 = static_cast<uint64_t>(
+                                it - conns_.begin())}};
+    ::epoll_ctl(epoll_, EPOLL_CTL_ADD, fd, &ev);
+  }
+}
+
+void PrometheusSink::receive(Conn& conn) {
+  while (true) {
+    if (conn.len == conn.in.size()) {
+      conn.head = kBadRequest;
+      break;
+    }
+    const ssize_t r =
+        ::recv(conn.fd, conn.in.data() + conn.len, conn.in.size() - conn.len, 0);
+    if (r < 0 && errno == EINTR) {
+      continue;
+    }
+    if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      return;
+    }
+    if (r <= 0) {
+      close(conn);
+      return;
+    }
+    conn.len += static_cast<size_t>(r);
+
+    const std::string_view request(conn.in.data(), conn.len);
+    if (request.find("\r\n\r\n") == std::string_view::npos) {
+      continue;
+    }
+
+    const auto& line = request.substr(0, request.find("\r\n"));
+    if (line.starts_with("GET /metrics ") ||
+        line.starts_with("GET /metrics?")) {
+      // Never re-render under a response that is still being written.
+      const bool busy = std::ranges::any_of(
+          conns_, [](const Conn& c) { return c.fd >= 0 && c.page; });
+      if (!rendered_ ||
+          (!busy && std::chrono::steady_clock::now() - rendered_at_ >=
+                        options_.interval)) {
+        render();
+      }
+      conn.head = head_;
+      conn.page = true;
+      scrapes_.fetch_add(1, std::memory_order_relaxed);
+    } else {
+      conn.head = kNotFound;
+    }
+    break;
+  }
+
+  epoll_event ev{.events = EPOLLOUT | EPOLLRDHUP,
+                 .data   = {.u64 = static_cast<uint64_t>(&conn - conns_.data())}};
+  ::epoll_ctl(epoll_, EPOLL_CTL_MOD, conn.fd, &ev);
+  respond(conn);
+}
+
+void PrometheusSink::respond(Conn& conn) {
+  const std::string_view body = conn.page ? page_ : std::string_view{};
+  const size_t total          = conn.head.size() + body.size();
+  while (conn.sent < total) {
+    std::array<iovec, 2> iov{};
+    int n = 0;
+    if (conn.sent < conn.head.size()) {
+      iov[n++] = {.iov_base = const_cast<char*>(conn.head.data() + conn.sent),
+                  .iov_len  = conn.head.size() - conn.sent};
+    }
+    const size_t off = conn.sent > conn.head.size()
+                           ? conn.sent - conn.head.size()
+                           : 0;
+    if (off < body.size()) {
+      iov[n++] = {.iov_base = const_cast<char*>(body.data() + off),
+                  .iov_len  = body.size() - off};
+    }
+
+    msghdr msg{};
+    msg.msg_iov    = iov.data();
+    msg.msg_iovlen = static_cast<size_t>(n);
+    const ssize_t w = ::sendmsg(conn.fd, &msg, MSG_NOSIGNAL);
+    if (w < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      break;
+    }
+    conn.sent += static_cast<size_t>(w);
+  }
+  close(conn);
+}
+
+void PrometheusSink::close(Conn& conn) {
+  if (conn.fd >= 0) {
+    ::epoll_ctl(epoll_, EPOLL_CTL_DEL, conn.fd, nullptr);
+    ::close(conn.fd);
+  }
+  conn.fd   = -1;
+  conn.page = false;
+  conn.head = {};
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "sink.hpp"
+#include "symbols.hpp"
+
+namespace bits::ttl {
+
+struct PrometheusOptions {
+  // The exposition page is re-rendered at most this often; scrapes in
+  // between are served from the cached page.
+  std::chrono::milliseconds interval{1000};
+  // Concurrent scrapes; connections beyond this are closed right away.
+  size_t connections = 8;
+};
+
+// Serves the latest captured state as Prometheus text exposition on
+// `GET /metrics` at `host:port` (IPv4, port 0 picks one, see address()).
+//   summary -> <name>{quantile="q"}, <name>_sum, <name>_count as a
+//              summary (sum and count totalled over all captures, the
+//              quantiles from the latest), other fields as
+//              <name>_<field> gauges
+//   others  -> <name> (the value field) and <name>_<field> gauges
+// Logs are not exported. Publishing only folds the batch into per-series
+// slots; rendering and HTTP happen on an epoll thread. The page, the
+// slots and their label strings are kept across scrapes, so once every
+// series has been seen a scrape allocates nothing.
+class PrometheusSink : public ISink {
+ public:
+  explicit PrometheusSink(std::string_view address,
+                          PrometheusOptions options = {});
+  ~PrometheusSink() override;
+
+  PrometheusSink(const PrometheusSink&)            = delete;
+  PrometheusSink& operator=(const PrometheusSink&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+
+  // Bound `host:port`.
+  [[nodiscard]] const std::string& address() const noexcept {
+    return address_;
+  }
+  [[nodiscard]] size_t scrapes() const noexcept {
+    return scrapes_.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] size_t renders() const noexcept {
+    return renders_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  struct Value {
+    Symbol key;
+    // Family name, or the quantile for summary quantiles.
+    std::string label;
+    bool quantile{false};
+    double v{0};
+  };
+
+  struct Series {
+    std::string name;
+    bool summary{false};
+    std::vector<Value> values;
+  };
+
+  struct Conn {
+    int fd{-1};
+    std::array<char, 1024> in{};
+    size_t len{0};
+    // Response being written: the page, or a canned reply when `page` is
+    // false.
+    std::string_view head;
+    bool page{false};
+    size_t sent{0};
+  };
+
+  void update(const Record& record, const Arena& arena);
+  Value& slot(Series& series, Symbol key);
+
+  void run(const std::stop_token& token);
+  void accept();
+  void receive(Conn& conn);
+  void respond(Conn& conn);
+  void close(Conn& conn);
+  void render();
+  void wake() const noexcept;
+
+  std::string address_;
+  PrometheusOptions options_;
+  int listen_{-1};
+  int epoll_{-1};
+  std::array<int, 2> pipe_{-1, -1};
+
+  // Shared between the publisher and the render.
+  std::mutex mutex_;
+  std::vector<Series> series_;
+  std::unordered_map<Symbol, size_t> index_;
+
+  // Server thread only.
+  std::vector<Conn> conns_;
+  std::string page_;
+  std::string head_;
+  std::chrono::steady_clock::time_point rendered_at_;
+  bool rendered_{false};
+
+  std::atomic<size_t> scrapes_{0};
+  std::atomic<size_t> renders_{0};
+  std::jthread thread_;
+
+  Symbol summary_;
+  Symbol log_;
+  Symbol value_;
+  Symbol count_;
+  Symbol sum_;
+};
+
+}  // namespace bits::ttl
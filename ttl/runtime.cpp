@@ -1,17 +1,50 @@
 #include "runtime.hpp"
+#include <bits/timer_wheel.hpp>
+#include <algorithm>
 #include <chrono>
 #include <condition_variable>
+#include <iterator>
 #include <memory>
 #include <mutex>
+#include <stop_token>
+#include <unordered_map>
+#include <utility>
 #include <vector>
+#include "collector.hpp"
 #include "counter.hpp"
+#include "deferred_log.hpp"
 #include "logger.hpp"
 #include "sink.hpp"
 #include "telemetry_object.hpp"
+#include "types.hpp"
 
 namespace bits::ttl::detail {
 using std::chrono::milliseconds;
 
+void FlushSignal::notify() {
+  {
+    std::unique_lock lock(mutex);
+    pending = true;
+  }
+  cond.notify_one();
+}
+
+void FlushSignal::notify(const ITelemetryObject* obj) {
+  {
+    std::unique_lock lock(mutex);
+    pressured.push_back(obj);
+  }
+  cond.notify_one();
+}
+
+void FlushSignal::add(ITelemetryObjectPtr obj) {
+  {
+    std::unique_lock lock(mutex);
+    added.push_back(std::move(obj));
+  }
+  cond.notify_one();
+}
+
 std::shared_ptr<Runtime> Runtime::instance() {
   static std::shared_ptr<Runtime> s{new Runtime()};
   return s;
@@ -19,36 +52,163 @@ std::shared_ptr<Runtime> Runtime::instance() {
 
 Runtime::~Runtime() {
   shutdown();
+  delete registry_.load(std::memory_order_relaxed);
 }
 
-void Runtime::init(std::unique_ptr<ISink> sink) {
+void Runtime::init(std::unique_ptr<ISink> sink, RuntimeOptions options) {
   if (flush_thread_) {
     throw std::runtime_error("Runtime already initialized. Call shutdown() first.");
   }
 
+  // A zero interval would make the flush thread spin.
+  options.interval = std::max(options.interval, milliseconds(1));
+
   this->sink_         = std::move(sink);
   this->flush_thread_ = std::make_unique<std::jthread>(
-      [this](const std::stop_token& token) {
-        std::mutex mutex;
-        std::condition_variable cond;
-        std::stop_callback callback(token, [&] { cond.notify_one(); });
+      [this, signal = signal_, options](const std::stop_token& token) {
+        using Clock      = std::chrono::steady_clock;
+        const auto start = Clock::now();
+        // Wheel ticks are milliseconds since start.
+        const auto tick = [&](Clock::time_point t) {
+          return static_cast<uint64_t>(
+              std::chrono::duration_cast<milliseconds>(t - start).count());
+        };
+
+        struct Scheduled {
+          ITelemetryObjectPtr obj;
+          uint64_t interval;
+          uint64_t due;
+        };
+        std::vector<Scheduled> scheduled;
+        // Object to its index in `scheduled`.
+        std::unordered_map<const ITelemetryObject*, size_t> known;
+        bits::TimerWheel<size_t> wheel;
+        std::vector<size_t> due;
+
+        const auto schedule = [&](const ITelemetryObjectPtr& obj) {
+          if (!known.emplace(obj.get(), scheduled.size()).second) {
+            return;
+          }
+          auto interval = obj->interval();
+          if (interval <= milliseconds::zero()) {
+            interval = options.interval;
+          }
+          const auto every =
+              std::max<uint64_t>(static_cast<uint64_t>(interval.count()), 1);
+          const uint64_t first = tick(Clock::now()) + every;
+          wheel.schedule(scheduled.size(), first);
+          scheduled.push_back({obj, every, first});
+        };
+
+        {
+          std::unique_lock lock(signal->mutex);
+          signal->added.clear();
+        }
+        forEachObject(schedule);
+
+        std::unique_ptr<CollectorPool> pool;
+        if (options.collectors > 1) {
+          pool = std::make_unique<CollectorPool>(options.collectors);
+        }
+
+        Arena arena;
+        std::vector<ITelemetryObject*> batch;
+        // Runs every round, even when nothing was captured, so sinks can
+        // act on time-based flush thresholds.
+        const auto capture = [&] {
+          arena.clear();
+          if (pool && batch.size() > 1) {
+            bool published = false;
+            for (const auto& part : pool->capture(batch)) {
+              if (!part.empty()) {
+                this->sink_->publishBatch(part);
+                published = true;
+              }
+            }
+            if (!published) {
+              this->sink_->publishBatch(arena);
+            }
+            return;
+          }
+
+          for (auto* obj : batch) {
+            obj->capture(arena);
+          }
+          this->sink_->publishBatch(arena);
+        };
 
+        const auto interval = static_cast<uint64_t>(options.interval.count());
+        std::vector<ITelemetryObjectPtr> added;
+        std::vector<const ITelemetryObject*> pressured;
         while (!token.stop_requested()) {
-          for (auto& obj : getObjects()) {
-            obj->capture(*this->sink_);
+          bool all = false;
+          {
+            std::unique_lock lock(signal->mutex);
+            std::swap(added, signal->added);
+            std::swap(pressured, signal->pressured);
+            all             = signal->pending;
+            signal->pending = false;
           }
+          for (auto& obj : added) {
+            schedule(obj);
+          }
+          added.clear();
+          this->publish();
+
+          // Only objects whose interval is up are touched.
+          const uint64_t now = tick(Clock::now());
+          due.clear();
+          wheel.advance(now, due);
 
-          const auto deadline =
-              std::chrono::steady_clock::now() + milliseconds(100);
+          batch.clear();
+          for (const size_t id : due) {
+            auto& s = scheduled[id];
+            if (!all) {
+              batch.push_back(s.obj.get());
+            }
+            s.due += s.interval;
+            if (s.due <= now) {
+              s.due = now + s.interval;
+            }
+            wheel.schedule(id, s.due);
+          }
+          // requestFlush() captures everything, buffer pressure only the
+          // objects that reported it.
+          if (all) {
+            for (auto& s : scheduled) {
+              batch.push_back(s.obj.get());
+            }
+          } else if (!pressured.empty()) {
+            for (const auto* obj : pressured) {
+              // Already due, or reported more than once.
+              const auto it = known.find(obj);
+              if (it != known.end() &&
+                  std::ranges::find(batch, obj) == batch.end()) {
+                batch.push_back(scheduled[it->second].obj.get());
+              }
+            }
+          }
+          pressured.clear();
+          capture();
 
-          std::unique_lock lock(mutex);
-          cond.wait_until(lock, deadline);
+          auto deadline = Clock::now() + options.interval;
+          if (const uint64_t next = wheel.next(); next <= now + interval) {
+            deadline = std::min(deadline, start + milliseconds(next));
+          }
+
+          std::unique_lock lock(signal->mutex);
+          signal->cond.wait_until(lock, token, deadline, [&] {
+            return signal->pending || !signal->pressured.empty() ||
+                   !signal->added.empty();
+          });
         }
 
         // Final flush before thread exits
-        for (auto& obj : getObjects()) {
-          obj->capture(*this->sink_);
-        }
+        batch.clear();
+        forEachObject(
+            [&](const ITelemetryObjectPtr& obj) { batch.push_back(obj.get()); });
+        capture();
+        this->sink_->flush();
       });
 }
 
@@ -60,46 +220,88 @@ void Runtime::shutdown() {
   }
 }
 
-template <typename T>
-std::shared_ptr<T> Runtime::makeObject(const std::string& name) {
+void Runtime::requestFlush() {
+  signal_->notify();
+}
+
+template <typename T, typename... Args>
+std::shared_ptr<T> Runtime::makeObject(const std::string& name,
+                                       Args&&... args) {
   {
-    std::shared_lock lock(mutex_);
-    const auto& it = obj_.find(name);
-    if (it != obj_.end()) {
-      return std::static_pointer_cast<T>(it->second);
+    const auto guard     = epoch_.pin();
+    const auto* registry = registry_.load(std::memory_order_seq_cst);
+    const auto& it       = registry->index.find(name);
+    if (it != registry->index.end()) {
+      return std::static_pointer_cast<T>(registry->objects[it->second]);
     }
   }
 
-  {
-    std::unique_lock lock(mutex_);
-    const auto& it = obj_.find(name);
-    if (it != obj_.end()) {
-      return std::static_pointer_cast<T>(it->second);
+  std::unique_lock lock(mutex_);
+  const auto* current = registry_.load(std::memory_order_relaxed);
+  for (const Registry* registry : {current, &std::as_const(pending_)}) {
+    const auto& it = registry->index.find(name);
+    if (it != registry->index.end()) {
+      return std::static_pointer_cast<T>(registry->objects[it->second]);
     }
-
-    auto impl  = std::make_shared<T>(name);
-    obj_[name] = impl;
-    return impl;
   }
+
+  auto impl = std::make_shared<T>(name, std::forward<Args>(args)...);
+  impl->attach([signal = signal_, obj = impl.get()] { signal->notify(obj); });
+
+  pending_.index.emplace(name, pending_.objects.size());
+  pending_.objects.push_back(impl);
+  has_pending_.store(true, std::memory_order_release);
+
+  signal_->add(impl);
+  return impl;
 }
 
-std::vector<ITelemetryObjectPtr> Runtime::getObjects() {
-  std::vector<ITelemetryObjectPtr> copy;
-  {
-    std::shared_lock lock(mutex_);
-    copy.reserve(obj_.size());
-    for (const auto& [name, obj] : obj_) {
-      copy.push_back(obj);
-    }
+void Runtime::publish() {
+  if (!has_pending_.load(std::memory_order_acquire)) {
+    return;
+  }
+
+  std::unique_lock lock(mutex_);
+  if (pending_.objects.empty()) {
+    return;
+  }
+  const auto* current = registry_.load(std::memory_order_relaxed);
+  auto next           = std::make_unique<Registry>(*current);
+  const size_t base   = next->objects.size();
+  for (auto& [name, idx] : pending_.index) {
+    next->index.emplace(name, base + idx);
   }
+  std::ranges::move(pending_.objects, std::back_inserter(next->objects));
+  pending_.index.clear();
+  pending_.objects.clear();
+  has_pending_.store(false, std::memory_order_relaxed);
 
-  return copy;
+  registry_.store(next.release(), std::memory_order_seq_cst);
+  epoch_.retire(current);
+  epoch_.reclaim();
 }
 
 template std::shared_ptr<bits::ttl::detail::CounterImpl>
 Runtime::makeObject<bits::ttl::detail::CounterImpl>(const std::string& name);
 
+template std::shared_ptr<bits::ttl::detail::CounterImpl>
+Runtime::makeObject<bits::ttl::detail::CounterImpl, bits::ttl::CounterOptions>(
+    const std::string& name, bits::ttl::CounterOptions&& options);
+
 template std::shared_ptr<bits::ttl::detail::LoggerImpl>
 Runtime::makeObject<bits::ttl::detail::LoggerImpl>(const std::string& name);
 
+template std::shared_ptr<bits::ttl::detail::LoggerImpl>
+Runtime::makeObject<bits::ttl::detail::LoggerImpl, bits::ttl::LoggerOptions>(
+    const std::string& name, bits::ttl::LoggerOptions&& options);
+
+template std::shared_ptr<bits::ttl::detail::DeferredLoggerImpl>
+Runtime::makeObject<bits::ttl::detail::DeferredLoggerImpl>(
+    const std::string& name);
+
+template std::shared_ptr<bits::ttl::detail::DeferredLoggerImpl>
+Runtime::makeObject<bits::ttl::detail::DeferredLoggerImpl,
+                    bits::ttl::DeferredLogOptions>(
+    const std::string& name, bits::ttl::DeferredLogOptions&& options);
+
 }  // namespace bits::ttl::detail
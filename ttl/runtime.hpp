@@ -1,20 +1,38 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 #include <memory>
-#include <shared_mutex>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
 #include <vector>
+#include <bits/epoch.hpp>
 #include "sink.hpp"
 #include "telemetry_object.hpp"
-
-namespace bits::ttl {
-class Ttl;
-}
+#include "ttl.hpp"
 
 namespace bits::ttl::detail {
 
+// Shared with registered objects, which may outlive the runtime.
+struct FlushSignal {
+  // Early capture of every object.
+  void notify();
+  // Early capture of `obj` only, e.g. when its buffer is under pressure.
+  void notify(const ITelemetryObject* obj);
+  // Hands a newly registered object to the flush thread for scheduling.
+  void add(ITelemetryObjectPtr obj);
+
+  std::mutex mutex;
+  std::condition_variable_any cond;
+  bool pending = false;
+  std::vector<const ITelemetryObject*> pressured;
+  std::vector<ITelemetryObjectPtr> added;
+};
+
 class Runtime {
  public:
   Runtime() = default;
@@ -27,19 +45,56 @@ class Runtime {
 
   static std::shared_ptr<Runtime> instance();
 
-  void init(std::unique_ptr<ISink> sink);
+  void init(std::unique_ptr<ISink> sink, RuntimeOptions options = {});
   void shutdown();
 
-  template <typename T>
-  std::shared_ptr<T> makeObject(const std::string& name);
+  // Wakes the flush thread for an immediate capture round.
+  void requestFlush();
 
-  std::vector<ITelemetryObjectPtr> getObjects();
+  template <typename T, typename... Args>
+  std::shared_ptr<T> makeObject(const std::string& name, Args&&... args);
+
+  // fn(const ITelemetryObjectPtr&) for every registered object, on the
+  // current snapshot: no reference counting, and no lock unless there are
+  // registrations left to publish.
+  template <typename Fn>
+  void forEachObject(Fn&& fn) {
+    publish();
+    const auto guard = epoch_.pin();
+    for (const auto& obj : registry_.load(std::memory_order_seq_cst)->objects) {
+      fn(obj);
+    }
+  }
 
  private:
-  std::shared_mutex mutex_;
-  std::unordered_map<std::string, ITelemetryObjectPtr> obj_;
+  struct NameHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view name) const noexcept {
+      return std::hash<std::string_view>{}(name);
+    }
+  };
+
+  // Immutable once published; publish() copies it, adds the pending
+  // objects and swaps the pointer, readers pin `epoch_` while they use it.
+  struct Registry {
+    std::unordered_map<std::string, size_t, NameHash, std::equal_to<>> index;
+    std::vector<ITelemetryObjectPtr> objects;
+  };
+
+  // Folds pending registrations into one new snapshot. Called every flush
+  // tick, so a burst of registrations costs one copy rather than one each.
+  void publish();
+
+  // Serializes registrations and guards `pending_`.
+  std::mutex mutex_;
+  std::atomic<const Registry*> registry_{new Registry};
+  // Registered but not yet in `registry_`; indices are into its objects.
+  Registry pending_;
+  std::atomic<bool> has_pending_{false};
+  bits::EpochDomain epoch_;
 
   std::unique_ptr<ISink> sink_;
+  std::shared_ptr<FlushSignal> signal_ = std::make_shared<FlushSignal>();
 
   std::unique_ptr<std::jthread> flush_thread_;
 };
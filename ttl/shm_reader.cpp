@@ -0,0 +1,127 @@
+#include "shm_reader.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include "shm_ring.hpp"
+
+namespace bits::ttl {
+
+namespace {
+const shm::Header* header(const void* base) {
+  return static_cast<const shm::Header*>(base);
+}
+}  // namespace
+
+ShmReader::ShmReader(std::string_view name, bool from_oldest) {
+  const auto shm_name = shm::shmName(name);
+  const int fd        = ::shm_open(shm_name.c_str(), O_RDONLY, 0);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::format("ttl: shm_open {}", shm_name));
+  }
+
+  struct stat st{};
+  if (::fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < shm::dataOffset(0)) {
+    ::close(fd);
+    throw std::runtime_error(std::format("ttl: {} is not a ring", shm_name));
+  }
+  size_ = static_cast<size_t>(st.st_size);
+  base_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  const int err = errno;
+  ::close(fd);
+  if (base_ == MAP_FAILED) {
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: mmap {}", shm_name));
+  }
+
+  // The header may be corrupt or hostile: a zero segment size would be
+  // divided by, and mappingSize() could overflow, so the segments are
+  // checked against the space left after the data offset instead.
+  const auto* h     = header(base_);
+  const size_t data = shm::dataOffset(h->segments);
+  const bool ok =
+      std::memcmp(h->magic, shm::kMagic.data(), shm::kMagic.size()) == 0 &&
+      h->version == shm::kVersion && h->segments >= 2 &&
+      h->segment_size != 0 && size_ >= data &&
+      (size_ - data) / h->segments >= h->segment_size;
+  if (!ok) {
+    ::munmap(base_, size_);
+    throw std::runtime_error(std::format("ttl: {} is not a ring", shm_name));
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+
+  segments_     = h->segments;
+  segment_size_ = h->segment_size;
+  data_ = static_cast<const char*>(base_) + shm::dataOffset(segments_);
+
+  const uint64_t head =
+      const_cast<shm::Header*>(h)->head.load(std::memory_order_acquire);
+  pos_ = from_oldest ? oldest(head) : head;
+}
+
+ShmReader::~ShmReader() {
+  ::munmap(base_, size_);
+}
+
+uint64_t ShmReader::oldest(uint64_t head) const noexcept {
+  // The segment being written and the segments-1 before it are intact.
+  const uint64_t current = head / segment_size_;
+  return current >= segments_ - 1 ? (current - (segments_ - 1)) * segment_size_
+                                  : 0;
+}
+
+bool ShmReader::next(std::string& out) {
+  auto& head_ref = const_cast<shm::Header*>(header(base_))->head;
+  auto* seq      = shm::seqs(base_);
+
+  while (true) {
+    const uint64_t head = head_ref.load(std::memory_order_acquire);
+    if (pos_ >= head) {
+      return false;
+    }
+    if (pos_ < oldest(head)) {
+      overruns_++;
+      pos_ = oldest(head);
+      continue;
+    }
+
+    const uint64_t segment = pos_ / segment_size_;
+    const uint64_t off     = pos_ % segment_size_;
+    const uint64_t next    = (segment + 1) * segment_size_;
+    const char* p          = data_ + (segment % segments_) * segment_size_ + off;
+
+    uint32_t len = 0;
+    if (segment_size_ - off >= sizeof(len)) {
+      std::memcpy(&len, p, sizeof(len));
+    }
+    const bool fits = len <= segment_size_ - off - sizeof(len);
+    if (fits && len != 0) {
+      out.assign(p + sizeof(len), len);
+    }
+
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (seq[segment % segments_].load(std::memory_order_relaxed) != segment) {
+      overruns_++;
+      pos_ = oldest(head_ref.load(std::memory_order_acquire));
+      continue;
+    }
+
+    if (len == 0 || !fits) {
+      // End-of-segment marker or padding.
+      pos_ = next;
+      continue;
+    }
+    pos_ += sizeof(len) + len;
+    return true;
+  }
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace bits::ttl {
+
+// Attaches read-only to a ring written by ShmSink. Any number of readers
+// can attach and detach at any time; the writer does not know about
+// them. Reading is plain loads, no syscalls.
+class ShmReader {
+ public:
+  // Starts at the newest message, or at the oldest intact one with
+  // `from_oldest`. Throws std::system_error if the ring does not exist
+  // and std::runtime_error if it is not a ttl ring.
+  explicit ShmReader(std::string_view name, bool from_oldest = false);
+  ~ShmReader();
+
+  ShmReader(const ShmReader&)            = delete;
+  ShmReader& operator=(const ShmReader&) = delete;
+
+  // Copies the next message into `out`, false when caught up.
+  bool next(std::string& out);
+
+  // Times the writer overtook this reader, each skipping at least one
+  // message.
+  [[nodiscard]] uint64_t overruns() const noexcept { return overruns_; }
+
+ private:
+  [[nodiscard]] uint64_t oldest(uint64_t head) const noexcept;
+
+  void* base_{nullptr};
+  size_t size_{0};
+  const char* data_{nullptr};
+  uint64_t segments_{0};
+  uint64_t segment_size_{0};
+  uint64_t pos_{0};
+  uint64_t overruns_{0};
+};
+
+}  // namespace bits::ttl
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// Shared-memory ring layout, shared by ShmSink and ShmReader.
+//
+// The ring is `segments` slots of `segment_size` bytes after a header
+// and a per-slot sequence array. Positions are global byte offsets that
+// only grow; position p lives in segment p / segment_size, slot
+// (p / segment_size) % segments. Messages are [u32 len][len bytes] and
+// never straddle segments, a zero len (or fewer than 4 bytes left) ends
+// a segment early.
+//
+// Writer: before reusing a slot for segment g it stores seq[slot] = g,
+// then writes messages and publishes them by advancing `head`.
+// Reader: reads up to `head`, then re-checks seq[slot]; if the writer has
+// moved on to g + segments meanwhile, what it read is discarded as an
+// overrun and it resyncs to the oldest intact segment.
+namespace bits::ttl::shm {
+
+constexpr std::string_view kMagic = "TTLS";
+constexpr uint32_t kVersion       = 1;
+
+struct Header {
+  char magic[4];
+  uint32_t version;
+  uint32_t segments;
+  uint32_t segment_size;
+  alignas(64) std::atomic<uint64_t> head;
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free);
+
+constexpr size_t kPage = 4096;
+
+constexpr size_t seqOffset() noexcept {
+  return (sizeof(Header) + 63) / 64 * 64;
+}
+
+constexpr size_t dataOffset(size_t segments) noexcept {
+  return (seqOffset() + segments * sizeof(uint64_t) + kPage - 1) / kPage *
+         kPage;
+}
+
+constexpr size_t mappingSize(size_t segments, size_t segment_size) noexcept {
+  return dataOffset(segments) + segments * segment_size;
+}
+
+inline std::atomic<uint64_t>* seqs(void* base) noexcept {
+  return reinterpret_cast<std::atomic<uint64_t>*>(static_cast<char*>(base) +
+                                                  seqOffset());
+}
+
+// POSIX shm names start with a single '/'.
+inline std::string shmName(std::string_view name) {
+  return name.starts_with('/') ? std::string(name) : "/" + std::string(name);
+}
+
+}  // namespace bits::ttl::shm
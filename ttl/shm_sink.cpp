@@ -0,0 +1,125 @@
+#include "shm_sink.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <new>
+#include <system_error>
+#include "json.hpp"
+#include "shm_ring.hpp"
+#include "types.hpp"
+
+namespace bits::ttl {
+
+ShmSink::ShmSink(std::string_view name, ShmOptions options)
+    : name_(shm::shmName(name)),
+      segments_(std::max<size_t>(options.segments, 2)),
+      segment_size_(std::max<size_t>(options.segment, 64)),
+      size_(shm::mappingSize(segments_, segment_size_)) {
+  const int fd = ::shm_open(name_.c_str(), O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            std::format("ttl: shm_open {}", name_));
+  }
+  if (::ftruncate(fd, static_cast<off_t>(size_)) != 0) {
+    const int err = errno;
+    ::close(fd);
+    ::shm_unlink(name_.c_str());
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: ftruncate {}", name_));
+  }
+
+  base_ = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int err = errno;
+  ::close(fd);
+  if (base_ == MAP_FAILED) {
+    ::shm_unlink(name_.c_str());
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: mmap {}", name_));
+  }
+  data_ = static_cast<char*>(base_) + shm::dataOffset(segments_);
+
+  auto* header = new (base_) shm::Header{};
+  header->version      = shm::kVersion;
+  header->segments     = static_cast<uint32_t>(segments_);
+  header->segment_size = static_cast<uint32_t>(segment_size_);
+  header->head.store(0, std::memory_order_relaxed);
+  auto* seq = shm::seqs(base_);
+  for (size_t i = 0; i < segments_; ++i) {
+    new (&seq[i]) std::atomic<uint64_t>(std::numeric_limits<uint64_t>::max());
+  }
+  // Readers check the magic last.
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(header->magic, shm::kMagic.data(), shm::kMagic.size());
+}
+
+ShmSink::~ShmSink() {
+  ::munmap(base_, size_);
+  ::shm_unlink(name_.c_str());
+}
+
+void ShmSink::publish(Event&& event) {
+  staging_.clear();
+  encodeJson(staging_, event);
+  write(staging_);
+  commit();
+}
+
+void ShmSink::publish(const Record& record, const Arena& arena) {
+  staging_.clear();
+  encodeJson(staging_, record, arena);
+  write(staging_);
+  commit();
+}
+
+void ShmSink::publishBatch(const Arena& arena) {
+  for (const auto& record : arena.records()) {
+    staging_.clear();
+    encodeJson(staging_, record, arena);
+    write(staging_);
+  }
+  commit();
+}
+
+void ShmSink::write(std::string_view message) {
+  const size_t need = sizeof(uint32_t) + message.size();
+  if (need > segment_size_) {
+    dropped_++;
+    return;
+  }
+
+  size_t off = head_ % segment_size_;
+  if (off + need > segment_size_) {
+    if (segment_size_ - off >= sizeof(uint32_t)) {
+      std::memset(data_ + (head_ / segment_size_ % segments_) * segment_size_ + off,
+                  0, sizeof(uint32_t));
+    }
+    head_ += segment_size_ - off;
+    off = 0;
+  }
+
+  const uint64_t segment = head_ / segment_size_;
+  const size_t slot      = segment % segments_;
+  if (off == 0) {
+    shm::seqs(base_)[slot].store(segment, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+  }
+
+  char* p         = data_ + slot * segment_size_ + off;
+  const auto len = static_cast<uint32_t>(message.size());
+  std::memcpy(p, &len, sizeof(len));
+  std::memcpy(p + sizeof(len), message.data(), message.size());
+  head_ += need;
+}
+
+void ShmSink::commit() {
+  static_cast<shm::Header*>(base_)->head.store(head_,
+                                               std::memory_order_release);
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "sink.hpp"
+
+namespace bits::ttl {
+
+struct ShmOptions {
+  // Bytes per segment, also the largest message that fits.
+  size_t segment = 1 << 20;
+  size_t segments = 8;
+};
+
+// Writes JSON lines into a shared-memory ring (see shm_ring.hpp) at
+// /dev/shm/<name>. Publishing is an encode plus memcpy and one atomic
+// store per batch; the writer never waits for readers, slow readers
+// detect the overrun instead. The ring is unlinked on destruction,
+// attached readers keep their mapping.
+class ShmSink : public ISink {
+ public:
+  explicit ShmSink(std::string_view name, ShmOptions options = {});
+  ~ShmSink() override;
+
+  ShmSink(const ShmSink&)            = delete;
+  ShmSink& operator=(const ShmSink&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+
+  // Messages larger than a segment, dropped.
+  [[nodiscard]] size_t dropped() const noexcept { return dropped_; }
+
+ private:
+  void write(std::string_view message);
+  void commit();
+
+  std::string name_;
+  size_t segments_;
+  size_t segment_size_;
+  void* base_{nullptr};
+  size_t size_{0};
+  char* data_{nullptr};
+  // Writer-side copy of the shared head.
+  uint64_t head_{0};
+  size_t dropped_{0};
+  std::string staging_;
+};
+
+}  // namespace bits::ttl
@@ -0,0 +1,51 @@
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include "shm_reader.hpp"
+
+using namespace bits::ttl;
+
+// Prints the messages of a shm:// sink to stdout as they arrive.
+//
+//   shm_tail <name> [--from-start]
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    std::cerr << "usage: " << argv[0] << " <name> [--from-start]\n";
+    return 2;
+  }
+  const bool from_start = argc > 2 && std::string_view(argv[2]) == "--from-start";
+
+  try {
+    ShmReader reader(argv[1], from_start);
+    std::string message;
+    uint64_t overruns = 0;
+    unsigned idle     = 0;
+    while (true) {
+      if (reader.next(message)) {
+        std::fwrite(message.data(), 1, message.size(), stdout);
+        idle = 0;
+        continue;
+      }
+
+      std::fflush(stdout);
+      if (reader.overruns() != overruns) {
+        overruns = reader.overruns();
+        std::cerr << "shm_tail: fell behind the writer, " << overruns
+                  << " overrun(s)\n";
+      }
+      // Spin briefly, then back off to a 1ms poll.
+      if (++idle < 1000) {
+        std::this_thread::yield();
+      } else {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "shm_tail: " << e.what() << "\n";
+    return 1;
+  }
+}
@@ -8,6 +8,23 @@ class ISink {
  public:
   virtual ~ISink() = default;
   virtual void publish(Event&& event) = 0;
+
+  // Capture path entry point. Sinks that encode records directly override
+  // this; the default converts to an Event.
+  virtual void publish(const Record& record, const Arena& arena) {
+    publish(arena.toEvent(record));
+  }
+
+  // Called by the runtime once per capture cycle with everything captured
+  // in that cycle. Override to amortize encoding and I/O over the batch.
+  virtual void publishBatch(const Arena& arena) {
+    for (const auto& record : arena.records()) {
+      publish(record, arena);
+    }
+  }
+
+  // Writes out anything the sink still holds. Called at shutdown.
+  virtual void flush() {}
 };
 
 }  // namespace bits::ttl
@@ -0,0 +1,67 @@
+#include "symbols.hpp"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include "throw_if_not.hpp"
+
+namespace bits::ttl {
+
+namespace {
+constexpr size_t kChunkBits = 10;
+constexpr size_t kChunkSize = size_t{1} << kChunkBits;
+constexpr size_t kMaxChunks = 4096;
+
+// Strings live in fixed-size chunks that never move, so lookup() can read
+// them without a lock while intern() appends.
+struct Table {
+  std::mutex mutex;
+  std::unordered_map<std::string_view, Symbol> index;
+  std::array<std::atomic<std::string*>, kMaxChunks> chunks{};
+  Symbol size = 0;
+};
+
+Table& table() {
+  // Never destroyed: sinks may still resolve symbols during static
+  // destruction (e.g. the final flush of the default runtime).
+  static auto* t = new Table();
+  return *t;
+}
+}  // namespace
+
+Symbol intern(std::string_view str) {
+  auto& t = table();
+  std::unique_lock lock(t.mutex);
+
+  const auto& it = t.index.find(str);
+  if (it != t.index.end()) {
+    return it->second;
+  }
+
+  const Symbol id    = t.size;
+  const size_t chunk = id >> kChunkBits;
+  bits::throwIfNot(chunk < kMaxChunks, "ttl: symbol table full");
+
+  auto* strings = t.chunks[chunk].load(std::memory_order_relaxed);
+  if (strings == nullptr) {
+    strings = new std::string[kChunkSize];
+    t.chunks[chunk].store(strings, std::memory_order_release);
+  }
+
+  auto& slot = strings[id & (kChunkSize - 1)];
+  slot       = std::string(str);
+  t.index.emplace(slot, id);
+  t.size++;
+  return id;
+}
+
+std::string_view lookup(Symbol id) noexcept {
+  const auto* strings =
+      table().chunks[id >> kChunkBits].load(std::memory_order_acquire);
+  return strings[id & (kChunkSize - 1)];
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+namespace bits::ttl {
+
+// Process-wide interned string id (event types, names, field keys).
+using Symbol = uint32_t;
+
+// Thread-safe; the same string always maps to the same id.
+Symbol intern(std::string_view str);
+
+// Lock-free; `id` must come from intern().
+std::string_view lookup(Symbol id) noexcept;
+
+}  // namespace bits::ttl
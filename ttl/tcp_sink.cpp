@@ -0,0 +1,258 @@
+#include "tcp_sink.hpp"
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <utility>
+#include <util.hpp>
+#include "json.hpp"
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+constexpr size_t kFrameHeader = sizeof(uint32_t);
+constexpr size_t kMaxSpare    = 16;
+}  // namespace
+
+TcpSink::TcpSink(std::string_view address, TcpOptions options)
+    : options_(options), backoff_(options.backoff_min) {
+  const auto& parsed = parseAddress(address);
+  // Connecting happens later on the I/O thread, which only takes IPv4
+  // literals; a host name would just fail and back off forever.
+  in_addr ip{};
+  if (!parsed || ::inet_pton(AF_INET, parsed->first.c_str(), &ip) != 1) {
+    throw std::invalid_argument(std::format("invalid address: {}", address));
+  }
+  host_ = parsed->first;
+  port_ = parsed->second;
+
+  pipe_  = makePipe();
+  epoll_ = makeEpoll();
+  epoll_event ev{.events = EPOLLIN, .data = {.fd = pipe_[0]}};
+  ::epoll_ctl(epoll_, EPOLL_CTL_ADD, pipe_[0], &ev);
+
+  thread_ = std::jthread([this](const std::stop_token& token) { run(token); });
+}
+
+TcpSink::~TcpSink() {
+  flush();
+  thread_.request_stop();
+  wake();
+  thread_.join();
+  disconnect();
+  ::close(epoll_);
+  ::close(pipe_[0]);
+  ::close(pipe_[1]);
+}
+
+void TcpSink::publish(Event&& event) {
+  encodeJson(frame(), event);
+  enqueue();
+}
+
+void TcpSink::publish(const Record& record, const Arena& arena) {
+  encodeJson(frame(), record, arena);
+  enqueue();
+}
+
+void TcpSink::publishBatch(const Arena& arena) {
+  if (arena.empty()) {
+    return;
+  }
+  encodeJson(frame(), arena);
+  enqueue();
+}
+
+void TcpSink::flush() {
+  std::unique_lock lock(mutex_);
+  drained_.wait_for(lock, options_.linger,
+                    [&] { return queue_.empty() && !busy_; });
+}
+
+std::string& TcpSink::frame() {
+  frame_.assign(kFrameHeader, '\0');
+  return frame_;
+}
+
+void TcpSink::enqueue() {
+  const auto len = toNetwork(static_cast<uint32_t>(frame_.size() - kFrameHeader));
+  std::memcpy(frame_.data(), &len, sizeof(len));
+
+  {
+    std::unique_lock lock(mutex_);
+    queued_ += frame_.size();
+    queue_.push_back(std::move(frame_));
+    while (queued_ > options_.queue && queue_.size() > 1) {
+      queued_ -= queue_.front().size();
+      queue_.pop_front();
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!spare_.empty()) {
+      frame_ = std::move(spare_.back());
+      spare_.pop_back();
+    } else {
+      frame_ = {};
+    }
+  }
+  wake();
+}
+
+void TcpSink::wake() const noexcept {
+  const char c = 0;
+  // The write end is non-blocking; EAGAIN means the pipe is full, which
+  // already guarantees a wakeup.
+  [[maybe_unused]] const auto n = ::write(pipe_[1], &c, 1);
+}
+
+void TcpSink::run(const std::stop_token& token) {
+  std::array<epoll_event, 4> events{};
+  while (!token.stop_requested()) {
+    const auto now = std::chrono::steady_clock::now();
+    if (sock_ < 0 && now >= retry_at_) {
+      connect();
+    }
+    if (sock_ >= 0 && !connecting_) {
+      send();
+    }
+
+    int timeout = -1;
+    if (sock_ < 0) {
+      timeout = static_cast<int>(
+          std::max<int64_t>(0, std::chrono::ceil<std::chrono::milliseconds>(
+                                   retry_at_ - std::chrono::steady_clock::now())
+                                   .count()));
+    }
+
+    const int n = ::epoll_wait(epoll_, events.data(),
+                               static_cast<int>(events.size()), timeout);
+    for (int i = 0; i < n; ++i) {
+      const auto& ev = events[static_cast<size_t>(i)];
+      if (ev.data.fd == pipe_[0]) {
+        char buf[256];
+        while (::read(pipe_[0], buf, sizeof(buf)) > 0) {
+        }
+        continue;
+      }
+      if (ev.data.fd != sock_) {
+        continue;
+      }
+
+      if (connecting_ && (ev.events & (EPOLLOUT | EPOLLERR | EPOLLHUP)) != 0) {
+        int err       = 0;
+        socklen_t len = sizeof(err);
+        ::getsockopt(sock_, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+          disconnect();
+          continue;
+        }
+        connecting_ = false;
+        backoff_    = options_.backoff_min;
+        connects_.fetch_add(1, std::memory_order_relaxed);
+      }
+      if ((ev.events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) != 0) {
+        disconnect();
+        continue;
+      }
+      if ((ev.events & EPOLLIN) != 0) {
+        // Nothing is expected back, drain and watch for EOF.
+        char buf[256];
+        ssize_t r = 0;
+        while ((r = ::recv(sock_, buf, sizeof(buf), 0)) > 0) {
+        }
+        if (r == 0) {
+          disconnect();
+        }
+      }
+    }
+  }
+}
+
+bool TcpSink::connect() {
+  sock_ = makeSockTcp();
+  if (sock_ < 0) {
+    disconnect();
+    return false;
+  }
+  setSockOptNonBlocking(sock_);
+  setSockOptTcpNoDelay(sock_);
+  setSockOptTcpKeepAlive(sock_);
+
+  epoll_event ev{.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+                 .data   = {.fd = sock_}};
+  ::epoll_ctl(epoll_, EPOLL_CTL_ADD, sock_, &ev);
+
+  sent_ = 0;
+  if (sockConnect(sock_, port_, host_) == 0) {
+    connecting_ = false;
+    backoff_    = options_.backoff_min;
+    connects_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+  }
+  if (errno == EINPROGRESS) {
+    connecting_ = true;
+    return true;
+  }
+  disconnect();
+  return false;
+}
+
+void TcpSink::disconnect() {
+  if (sock_ >= 0) {
+    ::epoll_ctl(epoll_, EPOLL_CTL_DEL, sock_, nullptr);
+    ::close(sock_);
+    sock_ = -1;
+  }
+  connecting_ = false;
+  sent_       = 0;
+  retry_at_   = std::chrono::steady_clock::now() + backoff_;
+  backoff_    = std::min(backoff_ * 2, options_.backoff_max);
+}
+
+bool TcpSink::send() {
+  while (true) {
+    if (current_.empty()) {
+      std::unique_lock lock(mutex_);
+      if (queue_.empty()) {
+        busy_ = false;
+        drained_.notify_all();
+        return true;
+      }
+      current_ = std::move(queue_.front());
+      queue_.pop_front();
+      queued_ -= current_.size();
+      busy_ = true;
+    }
+
+    const ssize_t n = ::send(sock_, current_.data() + sent_,
+                             current_.size() - sent_, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return true;
+      }
+      disconnect();
+      return false;
+    }
+
+    sent_ += static_cast<size_t>(n);
+    if (sent_ == current_.size()) {
+      sent_ = 0;
+      current_.clear();
+      std::unique_lock lock(mutex_);
+      if (spare_.size() < kMaxSpare) {
+        spare_.push_back(std::exchange(current_, {}));
+      }
+    }
+  }
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "sink.hpp"
+
+namespace bits::ttl {
+
+struct TcpOptions {
+  // Bytes of framed batches kept while the peer is slow or away; the
+  // oldest frames are dropped beyond this.
+  size_t queue = 4 << 20;
+  std::chrono::milliseconds backoff_min{100};
+  std::chrono::milliseconds backoff_max{10000};
+  // How long flush() (and so shutdown) waits for the queue to drain.
+  std::chrono::milliseconds linger{1000};
+};
+
+// Streams batches to `host:port` (IPv4) as frames of
+//   u32 length (network order) | JSON lines
+// One publishBatch() is one frame. Publishing only encodes and enqueues;
+// connecting, writing and reconnecting (with exponential backoff) happen
+// on an epoll-driven I/O thread. A frame cut short by a disconnect is
+// resent from its start on the next connection, so the peer only ever
+// sees whole frames. Throws std::invalid_argument when `host` is not an
+// IPv4 literal.
+class TcpSink : public ISink {
+ public:
+  explicit TcpSink(std::string_view address, TcpOptions options = {});
+  ~TcpSink() override;
+
+  TcpSink(const TcpSink&)            = delete;
+  TcpSink& operator=(const TcpSink&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+  void flush() override;
+
+  // Frames dropped from the queue.
+  [[nodiscard]] size_t dropped() const noexcept {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+  [[nodiscard]] size_t connects() const noexcept {
+    return connects_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  std::string& frame();
+  void enqueue();
+  void wake() const noexcept;
+
+  void run(const std::stop_token& token);
+  bool connect();
+  void disconnect();
+  bool send();
+
+  std::string host_;
+  uint16_t port_;
+  TcpOptions options_;
+
+  // Publisher side; the frame being encoded.
+  std::string frame_;
+
+  std::mutex mutex_;
+  std::condition_variable drained_;
+  std::deque<std::string> queue_;
+  size_t queued_{0};
+  // Emptied frames handed back to the publisher for reuse.
+  std::vector<std::string> spare_;
+
+  // Set while the I/O thread holds a frame outside the queue.
+  bool busy_{false};
+
+  // I/O thread only.
+  std::string current_;
+  int epoll_{-1};
+  int sock_{-1};
+  bool connecting_{false};
+  size_t sent_{0};
+  std::chrono::milliseconds backoff_;
+  std::chrono::steady_clock::time_point retry_at_;
+
+  std::array<int, 2> pipe_{-1, -1};
+  std::atomic<size_t> dropped_{0};
+  std::atomic<size_t> connects_{0};
+  std::jthread thread_;
+};
+
+}  // namespace bits::ttl
@@ -0,0 +1,173 @@
+#include "tee_sink.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stop_token>
+#include <thread>
+#include <utility>
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+// Cleared batches kept per branch for reuse.
+constexpr size_t kMaxSpare = 4;
+}  // namespace
+
+struct TeeSink::Branch {
+  Branch(std::unique_ptr<ISink> s, TeeOptions o)
+      : sink(std::move(s)), options(o) {
+    options.queue = std::max<size_t>(options.queue, 1);
+    worker = std::jthread([this](const std::stop_token& token) { run(token); });
+  }
+
+  void push(const Arena& arena) {
+    std::unique_lock lock(mutex);
+    // Empty batches only carry the runtime's tick; one queued batch of any
+    // kind delivers it just as well.
+    if (arena.empty() && (!queue.empty() || busy)) {
+      return;
+    }
+
+    if (queue.size() >= options.queue) {
+      switch (options.drop) {
+        case DropPolicy::Newest:
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          return;
+        case DropPolicy::Oldest:
+          recycle(std::move(queue.front()));
+          queue.pop_front();
+          dropped.fetch_add(1, std::memory_order_relaxed);
+          break;
+        case DropPolicy::Block:
+          cond.wait(lock, [&] { return queue.size() < options.queue; });
+          break;
+      }
+    }
+
+    Arena batch;
+    if (!spare.empty()) {
+      batch = std::move(spare.back());
+      spare.pop_back();
+    }
+    batch = arena;
+    queue.push_back(std::move(batch));
+    cond.notify_all();
+  }
+
+  void drain() {
+    std::unique_lock lock(mutex);
+    cond.wait(lock, [&] { return queue.empty() && !busy; });
+  }
+
+  void run(const std::stop_token& token) {
+    while (true) {
+      Arena batch;
+      {
+        std::unique_lock lock(mutex);
+        cond.wait(lock, token, [&] { return !queue.empty(); });
+        if (queue.empty()) {
+          return;
+        }
+        batch = std::move(queue.front());
+        queue.pop_front();
+        busy = true;
+        // Room for a blocked publisher.
+        cond.notify_all();
+      }
+
+      sink->publishBatch(batch);
+      batches.fetch_add(1, std::memory_order_relaxed);
+      records.fetch_add(batch.size(), std::memory_order_relaxed);
+
+      std::unique_lock lock(mutex);
+      recycle(std::move(batch));
+      busy = false;
+      cond.notify_all();
+    }
+  }
+
+  void recycle(Arena&& batch) {
+    if (spare.size() < kMaxSpare) {
+      batch.clear();
+      spare.push_back(std::move(batch));
+    }
+  }
+
+  std::unique_ptr<ISink> sink;
+  TeeOptions options;
+
+  std::mutex mutex;
+  std::condition_variable_any cond;
+  std::deque<Arena> queue;
+  std::vector<Arena> spare;
+  bool busy{false};
+
+  std::atomic<size_t> batches{0};
+  std::atomic<size_t> records{0};
+  std::atomic<size_t> dropped{0};
+
+  // Last, so it is joined before the rest goes away.
+  std::jthread worker;
+};
+
+TeeSink::TeeSink(std::vector<TeeBranch> branches) {
+  branches_.reserve(branches.size());
+  for (auto& branch : branches) {
+    branches_.push_back(
+        std::make_unique<Branch>(std::move(branch.sink), branch.options));
+  }
+}
+
+TeeSink::~TeeSink() {
+  flush();
+}
+
+void TeeSink::publish(Event&& event) {
+  publishBatch(Arena::fromEvent(event));
+}
+
+void TeeSink::publish(const Record& record, const Arena& arena) {
+  Arena single;
+  single.begin(record.type, record.name,
+               std::chrono::nanoseconds(record.timestamp));
+  for (const auto& f : arena.fields(record)) {
+    switch (f.kind) {
+      case Kind::Int:
+        single.add(f.key, f.i);
+        break;
+      case Kind::Double:
+        single.add(f.key, f.d);
+        break;
+      case Kind::String:
+        single.add(f.key, arena.str(f));
+        break;
+    }
+  }
+  publishBatch(single);
+}
+
+void TeeSink::publishBatch(const Arena& arena) {
+  for (auto& branch : branches_) {
+    branch->push(arena);
+  }
+}
+
+void TeeSink::flush() {
+  for (auto& branch : branches_) {
+    branch->drain();
+    branch->sink->flush();
+  }
+}
+
+TeeStats TeeSink::stats(size_t branch) const noexcept {
+  const auto& b = *branches_[branch];
+  return {.batches = b.batches.load(std::memory_order_relaxed),
+          .records = b.records.load(std::memory_order_relaxed),
+          .dropped = b.dropped.load(std::memory_order_relaxed)};
+}
+
+}  // namespace bits::ttl
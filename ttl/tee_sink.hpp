@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "sink.hpp"
+
+namespace bits::ttl {
+
+struct TeeOptions {
+  // Batches queued for the sink.
+  size_t queue = 64;
+  DropPolicy drop = DropPolicy::Oldest;
+};
+
+struct TeeBranch {
+  std::unique_ptr<ISink> sink;
+  TeeOptions options;
+};
+
+struct TeeStats {
+  size_t batches;
+  size_t records;
+  // Batches lost to the drop policy.
+  size_t dropped;
+};
+
+// Fans every batch out to several sinks. Each sink gets its own bounded
+// queue and worker thread, so a slow or stuck one only loses its own
+// batches (per its DropPolicy) instead of stalling the others.
+class TeeSink : public ISink {
+ public:
+  explicit TeeSink(std::vector<TeeBranch> branches);
+  ~TeeSink() override;
+
+  TeeSink(const TeeSink&)            = delete;
+  TeeSink& operator=(const TeeSink&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+  // Waits for every queue to drain, then flushes the sinks.
+  void flush() override;
+
+  [[nodiscard]] size_t size() const noexcept { return branches_.size(); }
+  [[nodiscard]] TeeStats stats(size_t branch) const noexcept;
+
+ private:
+  struct Branch;
+
+  std::vector<std::unique_ptr<Branch>> branches_;
+};
+
+}  // namespace bits::ttl
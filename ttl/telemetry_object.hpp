@@ -1,14 +1,26 @@
 #pragma once
 
+#include <chrono>
+#include <functional>
 #include <memory>
 
 namespace bits::ttl {
 
-class ISink;
+class Arena;
 
 struct ITelemetryObject {
-  virtual ~ITelemetryObject()       = default;
-  virtual void capture(ISink& sink) = 0;
+  virtual ~ITelemetryObject()        = default;
+  virtual void capture(Arena& arena) = 0;
+
+  // Called once on registration. `flush` asks the runtime for an early
+  // capture, e.g. when a buffer is about to overflow.
+  virtual void attach(std::function<void()> /*flush*/) {}
+
+  // How often the runtime captures this object; zero means the runtime's
+  // default interval. Read once on registration.
+  [[nodiscard]] virtual std::chrono::milliseconds interval() const {
+    return std::chrono::milliseconds::zero();
+  }
 };
 
 using ITelemetryObjectPtr = std::shared_ptr<ITelemetryObject>;
@@ -1,11 +1,19 @@
 #include <benchmark/benchmark.h>
 #include <bits/algo.hpp>
 #include <bits/ttl/counter.hpp>
+#include <bits/ttl/deferred_log.hpp>
 #include <bits/ttl/file_sink.hpp>
+#include <bits/ttl/json.hpp>
+#include <bits/ttl/logger.hpp>
+#include <bits/ttl/symbols.hpp>
 #include <bits/ttl/runtime.hpp>
+#include <charconv>
+#include <chrono>
 #include <cmath>
 #include <memory>
 #include <span>
+#include <string>
+#include <string_view>
 #include "ttl.hpp"
 
 using namespace bits::ttl;
@@ -61,4 +69,184 @@ BENCHMARK(BM_MetricRecord)
     ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
     ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
 
+static void BM_AggregateRecord(benchmark::State& state) {
+  if (state.thread_index() == 0) {
+    Ttl::init("discard://");
+  }
+
+  Counter c("bench.aggregate", CounterOptions{.mode = CounterMode::Aggregate});
+
+  double value = 100.0;
+  for (auto _ : state) {
+    c += value;
+    value += 0.1;
+    benchmark::DoNotOptimize(value);
+  }
+
+  if (state.thread_index() == 0) {
+    Ttl::shutdown();
+  }
+}
+
+BENCHMARK(BM_AggregateRecord)
+    ->Threads(1)
+    ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
+    ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
+
+BENCHMARK(BM_AggregateRecord)
+    ->Threads(2)
+    ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
+    ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
+
+BENCHMARK(BM_AggregateRecord)
+    ->Threads(4)
+    ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
+    ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
+
+BENCHMARK(BM_AggregateRecord)
+    ->Threads(8)
+    ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
+    ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
+
+BENCHMARK(BM_AggregateRecord)
+    ->Threads(60)
+    ->ComputeStatistics("max", HistogramAdapter<bits::Histogram<100, 100>>)
+    ->ComputeStatistics("p99", HistogramAdapter<bits::Histogram<99, 100>>);
+
+// The encoder as it was before escaping: appends byte by byte, no escapes.
+static void encodeJsonBaseline(std::string& out, const Record& record,
+                               const Arena& arena) {
+  const auto append = [&](std::string_view sv) {
+    for (const char c : sv) {
+      out.push_back(c);
+    }
+  };
+  const auto number = [&](auto v) {
+    char buf[32];
+    auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+    append({buf, ec == std::errc() ? ptr : buf});
+  };
+
+  append(R"({"type":")");
+  append(lookup(record.type));
+  append(R"(","name":")");
+  append(lookup(record.name));
+  append(R"(","ts":)");
+  number(record.timestamp);
+  for (const auto& f : arena.fields(record)) {
+    append(",\"");
+    append(lookup(f.key));
+    append("\":");
+    switch (f.kind) {
+      case Kind::Int:
+        number(f.i);
+        break;
+      case Kind::Double:
+        number(f.d);
+        break;
+      case Kind::String:
+        append("\"");
+        append(arena.str(f));
+        append("\"");
+        break;
+    }
+  }
+  append("}\n");
+}
+
+// A capture cycle's worth of summaries and log lines.
+static Arena encodeBatch() {
+  Arena arena;
+  for (int64_t i = 0; i < 256; i++) {
+    arena.begin(intern("summary"), intern("bench.encode.latency"),
+                std::chrono::nanoseconds(1700000000000000000 + i));
+    arena.add(intern("count"), i * 7);
+    arena.add(intern("sum"), 1234.5678 * static_cast<double>(i));
+    arena.add(intern("p99"), 0.1 * static_cast<double>(i));
+    arena.begin(intern("log"), intern("bench.encode.log"),
+                std::chrono::nanoseconds(1700000000000000000 + i));
+    arena.add(intern("level"), std::string_view("Info"));
+    arena.add(intern("message"),
+              std::string_view("request served from cache in the usual "
+                               "amount of time, nothing to see here"));
+  }
+  return arena;
+}
+
+static void BM_EncodeJsonBaseline(benchmark::State& state) {
+  const auto arena = encodeBatch();
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    for (const auto& record : arena.records()) {
+      encodeJsonBaseline(out, record, arena);
+    }
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+}
+
+BENCHMARK(BM_EncodeJsonBaseline);
+
+static void BM_EncodeJson(benchmark::State& state) {
+  const auto arena = encodeBatch();
+  std::string out;
+  for (auto _ : state) {
+    out.clear();
+    encodeJson(out, arena);
+    benchmark::DoNotOptimize(out.data());
+  }
+  state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * out.size()));
+}
+
+BENCHMARK(BM_EncodeJson);
+
+static void BM_LogStream(benchmark::State& state) {
+  auto rt = std::make_shared<detail::Runtime>();
+  rt->init(std::make_unique<Discard>());
+  Logger logger{rt};
+  for (auto _ : state) {
+    LogStream(logger, Info) << "served " << "/index" << " in " << 42 << "us";
+  }
+}
+
+BENCHMARK(BM_LogStream);
+
+static void BM_LogKV(benchmark::State& state) {
+  auto rt = std::make_shared<detail::Runtime>();
+  rt->init(std::make_unique<Discard>());
+  Logger logger{rt};
+  for (auto _ : state) {
+    logger.log(Info, "served", {kv<"path">("/index"), kv<"us">(42)});
+  }
+}
+
+BENCHMARK(BM_LogKV);
+
+static void BM_LogDisabled(benchmark::State& state) {
+  setLogLevel("bench.quiet", Warn);
+  for (auto _ : state) {
+    TTL_LOGM("bench.quiet", Debug) << "served " << "/index" << " in " << 42;
+  }
+  clearLogLevel("bench.quiet");
+}
+
+BENCHMARK(BM_LogDisabled);
+
+static void BM_DeferredLog(benchmark::State& state) {
+  static const LogSite site{Info, "served {} in {}us", __FILE__, __LINE__};
+  auto rt = std::make_shared<detail::Runtime>();
+  // A tight loop outruns the flush thread; entries it drops are counted.
+  rt->init(std::make_unique<Discard>(),
+           RuntimeOptions{.interval = std::chrono::milliseconds(1)});
+  DeferredLogger logger{rt,
+                        DeferredLogOptions{.buffer = 16 << 20, .path = {}}};
+  for (auto _ : state) {
+    logger.log(site, "/index", 42);
+  }
+  state.counters["dropped"] = static_cast<double>(logger.dropped());
+}
+
+BENCHMARK(BM_DeferredLog);
+
 BENCHMARK_MAIN();
@@ -0,0 +1,189 @@
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <cmath>
+#include <fstream>
+#include <hash.hpp>
+#include <string>
+#include <vector>
+#include "binary.hpp"
+#include "binary_reader.hpp"
+#include "binary_sink.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+
+namespace {
+void fill(Arena& arena, int64_t from, int64_t n) {
+  for (int64_t i = from; i < from + n; i++) {
+    arena.begin(intern("metric"), intern("test.binary"),
+                std::chrono::nanoseconds(1'000'000 * i));
+    arena.add(intern("count"), -i);
+    arena.add(intern("value"), 100.0 + 0.25 * static_cast<double>(i % 4));
+    arena.add(intern("unit"), std::string_view("ms"));
+  }
+}
+}  // namespace
+
+TEST(Crc32cTest, KnownVector) {
+  const std::string_view s = "123456789";
+  EXPECT_EQ(bits::crc32c(std::as_bytes(std::span(s))), 0xE3069283U);
+}
+
+TEST(BinaryTest, RoundTrip) {
+  const char* path = "/tmp/ttl_test_binary.bin";
+  unlink(path);
+  {
+    BinaryFile sink(path, BinaryOptions{.block = 512});
+    Arena arena;
+    fill(arena, 0, 1000);
+    sink.publishBatch(arena);
+  }
+
+  SegmentReader reader(path);
+  int64_t i = 0;
+  while (auto r = reader.next()) {
+    EXPECT_EQ(r->type, "metric");
+    EXPECT_EQ(r->name, "test.binary");
+    EXPECT_EQ(r->timestamp.count(), 1'000'000 * i);
+    ASSERT_EQ(r->fields.size(), 3);
+    EXPECT_EQ(r->fields[0].key, "count");
+    EXPECT_EQ(r->fields[0].i, -i);
+    EXPECT_EQ(r->fields[1].kind, Kind::Double);
+    EXPECT_EQ(r->fields[1].d, 100.0 + 0.25 * static_cast<double>(i % 4));
+    EXPECT_EQ(r->fields[2].s, "ms");
+    i++;
+  }
+  EXPECT_EQ(i, 1000);
+  EXPECT_EQ(reader.corrupt(), 0);
+
+  unlink(path);
+}
+
+TEST(BinaryTest, SmallerThanJson) {
+  const char* path = "/tmp/ttl_test_binary_size.bin";
+  unlink(path);
+  {
+    BinaryFile sink(path);
+    Arena arena;
+    fill(arena, 0, 1000);
+    sink.publishBatch(arena);
+  }
+
+  std::ifstream in(path, std::ios::binary | std::ios::ate);
+  // The equivalent JSON lines are ~90 bytes per record.
+  EXPECT_LT(in.tellg(), 1000 * 20);
+
+  unlink(path);
+}
+
+TEST(BinaryTest, AppendedSegmentsAndCorruptBlocks) {
+  const char* path = "/tmp/ttl_test_binary_corrupt.bin";
+  unlink(path);
+  for (int64_t s = 0; s < 3; s++) {
+    BinaryFile sink(path, BinaryOptions{.xor_doubles = s != 1});
+    Arena arena;
+    fill(arena, s * 10, 10);
+    sink.publishBatch(arena);
+  }
+
+  // Flip one byte in the last block's payload.
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(-3, std::ios::end);
+    f.put('\xff');
+  }
+
+  SegmentReader reader(path);
+  std::vector<int64_t> counts;
+  while (auto r = reader.next()) {
+    counts.push_back(-r->fields[0].i);
+  }
+  ASSERT_EQ(counts.size(), 20);
+  for (int64_t i = 0; i < 20; i++) {
+    EXPECT_EQ(counts[i], i);
+  }
+  EXPECT_EQ(reader.corrupt(), 1);
+
+  unlink(path);
+}
+
+TEST(BinaryTest, CorruptFirstBlockKeepsLaterSymbols) {
+  const char* path = "/tmp/ttl_test_binary_first.bin";
+  unlink(path);
+  {
+    BinaryFile sink(path, BinaryOptions{.block = 256});
+    Arena arena;
+    fill(arena, 0, 100);
+    sink.publishBatch(arena);
+  }
+
+  // Flip a byte inside the first block, which used to be the only one
+  // defining the symbols.
+  {
+    std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+    f.seekp(binary::kHeaderSize + binary::kBlockHeaderSize + 4);
+    f.put('\xff');
+  }
+
+  SegmentReader reader(path);
+  int64_t records = 0;
+  while (auto r = reader.next()) {
+    EXPECT_EQ(r->type, "metric");
+    EXPECT_EQ(r->name, "test.binary");
+    ASSERT_EQ(r->fields.size(), 3);
+    EXPECT_EQ(r->fields[0].key, "count");
+    EXPECT_EQ(r->fields[2].key, "unit");
+    EXPECT_EQ(r->fields[2].s, "ms");
+    records++;
+  }
+  EXPECT_GT(records, 0);
+  EXPECT_LT(records, 100);
+  EXPECT_EQ(reader.corrupt(), 1);
+
+  unlink(path);
+}
+
+TEST(BinaryTest, HugeIdsAreCorrupt) {
+  const char* path = "/tmp/ttl_test_binary_ids.bin";
+  unlink(path);
+  {
+    BinaryFile sink(path);
+    Arena arena;
+    fill(arena, 0, 1);
+    sink.publishBatch(arena);
+  }
+
+  // A well-formed block whose symbol id would need terabytes.
+  std::string payload;
+  payload.push_back(static_cast<char>(binary::Tag::Symbol));
+  binary::putVarint(payload, uint64_t{1} << 40);
+  binary::putVarint(payload, 1);
+  payload.push_back('x');
+  {
+    const auto u32 = [](std::ofstream& out, uint32_t v) {
+      out.write(reinterpret_cast<const char*>(&v), sizeof(v));
+    };
+    std::ofstream out(path, std::ios::binary | std::ios::app);
+    u32(out, static_cast<uint32_t>(payload.size()));
+    u32(out, bits::crc32c(std::as_bytes(std::span(payload))));
+    out << payload;
+  }
+
+  SegmentReader reader(path);
+  EXPECT_TRUE(reader.next().has_value());
+  EXPECT_FALSE(reader.next().has_value());
+  EXPECT_EQ(reader.corrupt(), 1);
+
+  unlink(path);
+}
+
+TEST(BinaryTest, RejectsOtherFiles) {
+  const char* path = "/tmp/ttl_test_binary_other.bin";
+  {
+    std::ofstream out(path);
+    out << R"({"type":"metric"})" << "\n";
+  }
+  EXPECT_THROW(SegmentReader{path}, std::runtime_error);
+  unlink(path);
+}
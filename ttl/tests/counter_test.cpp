@@ -1,10 +1,21 @@
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <map>
 #include <ring_buffer.hpp>
 #include <thread>
 #include <vector>
+#include "collector.hpp"
 #include "counter.hpp"
 #include "file_sink.hpp"
+#include "json.hpp"
 #include "runtime.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+#include "uring_sink.hpp"
 
 using namespace bits::ttl;
 
@@ -18,6 +29,13 @@ class MockSink : public ISink {
     events_->push_back(std::move(event));
   }
 
+  void publishBatch(const Arena& arena) override {
+    std::unique_lock lock(mutex_);
+    for (const auto& record : arena.records()) {
+      events_->push_back(arena.toEvent(record));
+    }
+  }
+
   [[nodiscard]] std::vector<Event> events() const {
     std::vector<Event> copy;
     {
@@ -169,6 +187,108 @@ TEST(CounterTest, SharedImplementation) {
   EXPECT_EQ(c1.name(), "test.shared");
 }
 
+TEST(CounterTest, ConcurrentRegistration) {
+  auto events = std::make_shared<std::vector<Event>>();
+  auto sink   = std::make_unique<MockSink>(events);
+  auto* mock  = sink.get();
+  auto rt     = std::make_shared<detail::Runtime>();
+  rt->init(std::move(sink));
+
+  // Every thread registers the same 50 names; each name gets one object.
+  std::vector<std::jthread> threads;
+  for (int t = 0; t < 8; t++) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 50; i++) {
+        Counter c("test.registry." + std::to_string(i),
+                  CounterOptions{.mode = CounterMode::Aggregate}, rt);
+        c += 1.0;
+      }
+    });
+  }
+  threads.clear();
+
+  size_t objects = 0;
+  rt->forEachObject([&](const ITelemetryObjectPtr&) { objects++; });
+  EXPECT_EQ(objects, 50U);
+
+  rt->shutdown();
+  std::map<std::string, double> counts;
+  for (const auto& e : mock->events()) {
+    for (const auto& f : e.fields) {
+      if (f.key == "count") {
+        counts[e.name] += static_cast<double>(std::get<int64_t>(f.value));
+      }
+    }
+  }
+  ASSERT_EQ(counts.size(), 50U);
+  for (const auto& [name, count] : counts) {
+    EXPECT_EQ(count, 8) << name;
+  }
+}
+
+TEST(CounterTest, ParallelCollectors) {
+  auto events = std::make_shared<std::vector<Event>>();
+  auto sink   = std::make_unique<MockSink>(events);
+  auto* mock  = sink.get();
+  auto rt     = std::make_shared<detail::Runtime>();
+  rt->init(std::move(sink), RuntimeOptions{.collectors = 4});
+
+  std::vector<Counter> counters;
+  for (int i = 0; i < 200; i++) {
+    counters.emplace_back("test.collectors." + std::to_string(i),
+                          CounterOptions{.mode = CounterMode::Aggregate}, rt);
+  }
+  for (int round = 0; round < 3; round++) {
+    for (auto& c : counters) {
+      c += 1.0;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  }
+  rt->shutdown();
+
+  std::map<std::string, int64_t> counts;
+  for (const auto& e : mock->events()) {
+    for (const auto& f : e.fields) {
+      if (f.key == "count") {
+        counts[e.name] += std::get<int64_t>(f.value);
+      }
+    }
+  }
+  ASSERT_EQ(counts.size(), 200U);
+  for (const auto& [name, count] : counts) {
+    EXPECT_EQ(count, 3) << name;
+  }
+}
+
+TEST(CollectorPoolTest, CapturesEveryObjectOnce) {
+  struct Object : ITelemetryObject {
+    void capture(Arena& arena) override {
+      captures.fetch_add(1);
+      arena.begin(intern("metric"), intern("test.pool"),
+                  std::chrono::nanoseconds(0));
+    }
+    std::atomic<int> captures{0};
+  };
+
+  std::vector<Object> objects(1000);
+  std::vector<ITelemetryObject*> batch;
+  for (auto& o : objects) {
+    batch.push_back(&o);
+  }
+
+  detail::CollectorPool pool(4);
+  for (int round = 0; round < 20; round++) {
+    size_t records = 0;
+    for (const auto& part : pool.capture(batch)) {
+      records += part.size();
+    }
+    EXPECT_EQ(records, objects.size());
+  }
+  for (const auto& o : objects) {
+    EXPECT_EQ(o.captures.load(), 20);
+  }
+}
+
 TEST(CounterTest, MultipleCounters) {
   auto events = std::make_shared<std::vector<Event>>();
   {
@@ -231,6 +351,41 @@ TEST(CounterTest, FlushLoop) {
   unlink("/tmp/ttl_test_flush.log");
 }
 
+TEST(CounterTest, PerObjectIntervals) {
+  auto events = std::make_shared<std::vector<Event>>();
+  auto sink   = std::make_unique<MockSink>(events);
+  auto* mock  = sink.get();
+  auto rt     = std::make_shared<detail::Runtime>();
+  rt->init(std::move(sink), RuntimeOptions{.interval = std::chrono::hours(1)});
+
+  Counter fast("test.interval.fast",
+               CounterOptions{.mode     = CounterMode::Aggregate,
+                              .interval = std::chrono::milliseconds(10)},
+               rt);
+  Counter slow("test.interval.slow",
+               CounterOptions{.mode = CounterMode::Aggregate}, rt);
+
+  for (int i = 0; i < 20; i++) {
+    fast += 1.0;
+    slow += 1.0;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+
+  // The fast counter is captured on its own interval, the slow one waits
+  // for the (hour-long) default.
+  size_t fast_events = 0;
+  for (const auto& e : mock->events()) {
+    EXPECT_EQ(e.name, "test.interval.fast");
+    fast_events++;
+  }
+  EXPECT_GE(fast_events, 5U);
+
+  rt->shutdown();
+  const auto& all = mock->events();
+  EXPECT_TRUE(std::ranges::any_of(
+      all, [](const Event& e) { return e.name == "test.interval.slow"; }));
+}
+
 TEST(CounterTest, IdempotentInit) {
   auto rt = std::make_shared<detail::Runtime>();
   rt->init(std::make_unique<Discard>());
@@ -242,6 +397,134 @@ TEST(CounterTest, IdempotentInit) {
   c += 1.0;
 }
 
+TEST(CounterTest, SketchSummary) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+
+    Counter c("test.sketch",
+              CounterOptions{.mode = CounterMode::Sketch, .quantiles = {0.29, 0.5, 0.99}},
+              rt);
+    for (int i = 1; i <= 1000; i++) {
+      c += static_cast<double>(i);
+    }
+  }
+
+  ASSERT_GE(events->size(), 1);
+
+  int64_t count = 0;
+  for (const auto& event : *events) {
+    EXPECT_EQ(event.name, "test.sketch");
+    EXPECT_EQ(event.type, "summary");
+
+    std::vector<std::string> keys;
+    for (const auto& field : event.fields) {
+      keys.push_back(field.key);
+      if (field.key == "count") {
+        count += std::get<int64_t>(field.value);
+      }
+    }
+    EXPECT_EQ(keys, (std::vector<std::string>{"count", "sum", "min", "max",
+                                              "p29", "p50", "p99"}));
+  }
+
+  EXPECT_EQ(count, 1000);
+}
+
+TEST(CounterTest, AggregateSummary) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+
+    Counter c("test.aggregate", CounterOptions{.mode = CounterMode::Aggregate},
+              rt);
+    std::thread([&] {
+      for (int i = 1; i <= 100; i++) {
+        c += static_cast<double>(i);
+      }
+    }).join();
+    c += 1000.0;
+  }
+
+  int64_t count = 0;
+  double sum    = 0;
+  double max    = 0;
+  for (const auto& event : *events) {
+    EXPECT_EQ(event.name, "test.aggregate");
+    EXPECT_EQ(event.type, "summary");
+    for (const auto& field : event.fields) {
+      if (field.key == "count") {
+        count += std::get<int64_t>(field.value);
+      } else if (field.key == "sum") {
+        sum += std::get<double>(field.value);
+      } else if (field.key == "max") {
+        max = std::max(max, std::get<double>(field.value));
+      }
+    }
+  }
+
+  EXPECT_EQ(count, 101);
+  EXPECT_DOUBLE_EQ(sum, 6050.0);
+  EXPECT_DOUBLE_EQ(max, 1000.0);
+}
+
+TEST(CounterTest, DroppedSamplesReported) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    Counter c("test.dropped", CounterOptions{.slots = 16}, rt);
+    for (int i = 0; i < 100; i++) {
+      c += static_cast<double>(i);
+    }
+    rt->init(std::make_unique<MockSink>(events));
+  }
+
+  ASSERT_EQ(events->size(), 16);
+  for (const auto& event : *events) {
+    for (const auto& field : event.fields) {
+      if (field.key == "count") {
+        EXPECT_EQ(std::get<int64_t>(field.value), 100);
+      } else if (field.key == "dropped") {
+        EXPECT_EQ(std::get<int64_t>(field.value), 84);
+      }
+    }
+  }
+}
+
+TEST(CounterTest, PressureTriggersEarlyFlush) {
+  auto events = std::make_shared<std::vector<Event>>();
+  auto sink   = std::make_unique<MockSink>(events);
+  auto* mock  = sink.get();
+  auto rt     = std::make_shared<detail::Runtime>();
+  // Far longer than the test, so only pressure can trigger the flush.
+  rt->init(std::move(sink), {.interval = std::chrono::seconds(60)});
+
+  // Not under pressure, so the early flush leaves it alone.
+  Counter idle("test.idle", CounterOptions{}, rt);
+  idle += 1.0;
+
+  // Fill past the high-water mark.
+  Counter c("test.pressure", CounterOptions{.slots = 16}, rt);
+  for (int i = 0; i < 13; i++) {
+    c += 1.0;
+  }
+
+  const auto deadline =
+      std::chrono::steady_clock::now() + std::chrono::seconds(10);
+  while (mock->events().size() < 13 &&
+         std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  EXPECT_EQ(mock->events().size(), 13);
+  for (const auto& event : mock->events()) {
+    EXPECT_EQ(event.name, "test.pressure");
+  }
+
+  rt->shutdown();
+}
+
 TEST(RingBufferTest, Wraparound) {
   bits::RingBuffer<double, 4> rb;
 
@@ -270,3 +553,289 @@ TEST(FileSinkTest, WriteEvents) {
 
   unlink("/tmp/ttl_test_sink.log");
 }
+
+TEST(SymbolTest, InternIsStable) {
+  const Symbol a = intern("test.symbol");
+  EXPECT_EQ(intern("test.symbol"), a);
+  EXPECT_NE(intern("test.symbol.other"), a);
+  EXPECT_EQ(lookup(a), "test.symbol");
+}
+
+TEST(ArenaTest, RecordRoundTrip) {
+  Arena arena;
+  arena.begin(intern("metric"), intern("test.arena"),
+              std::chrono::nanoseconds(42));
+  arena.add(intern("count"), int64_t(3));
+  arena.add(intern("avg"), 1.5);
+  arena.add(intern("unit"), std::string_view("ms"));
+
+  ASSERT_EQ(arena.size(), 1);
+  const auto event = arena.toEvent(arena.records()[0]);
+  EXPECT_EQ(event.type, "metric");
+  EXPECT_EQ(event.name, "test.arena");
+  EXPECT_EQ(event.timestamp.count(), 42);
+  ASSERT_EQ(event.fields.size(), 3);
+  EXPECT_EQ(std::get<int64_t>(event.fields[0].value), 3);
+  EXPECT_DOUBLE_EQ(std::get<double>(event.fields[1].value), 1.5);
+  EXPECT_EQ(std::get<std::string>(event.fields[2].value), "ms");
+
+  arena.clear();
+  EXPECT_TRUE(arena.empty());
+}
+
+TEST(ArenaTest, IntegerLiteralsAreInts) {
+  Arena arena;
+  arena.begin(intern("metric"), intern("test.arena.int"),
+              std::chrono::nanoseconds(0));
+  arena.add(intern("a"), 1);
+  arena.add(intern("b"), 2u);
+  arena.add(intern("c"), size_t{3});
+
+  const auto event = arena.toEvent(arena.records()[0]);
+  ASSERT_EQ(event.fields.size(), 3);
+  EXPECT_EQ(std::get<int64_t>(event.fields[0].value), 1);
+  EXPECT_EQ(std::get<int64_t>(event.fields[1].value), 2);
+  EXPECT_EQ(std::get<int64_t>(event.fields[2].value), 3);
+}
+
+TEST(FileSinkTest, WriteRecords) {
+  const char* path = "/tmp/ttl_test_records.log";
+  unlink(path);
+  {
+    File sink(path);
+    Arena arena;
+    arena.begin(intern("log"), intern("test.file"),
+                std::chrono::nanoseconds(7));
+    arena.add(intern("level"), std::string_view("Info"));
+    arena.add(intern("count"), int64_t(2));
+    sink.publish(arena.records()[0], arena);
+  }
+
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  EXPECT_EQ(line,
+            R"({"type":"log","name":"test.file","ts":7,"level":"Info","count":2})");
+
+  unlink(path);
+}
+
+TEST(JsonTest, EscapesStrings) {
+  // Long enough to take the vector path, escapes on both sides of a block.
+  const std::string message =
+      "a \"quoted\" path C:\\tmp\nnext line\ttab and a bell \x07 at the end";
+  Arena arena;
+  arena.begin(intern("log"), intern("test.\"json\""),
+              std::chrono::nanoseconds(1));
+  arena.add(intern("message"), std::string_view(message));
+  arena.add(intern("nan"), std::nan(""));
+  arena.add(intern("half"), 0.5);
+
+  std::string out;
+  encodeJson(out, arena);
+  EXPECT_EQ(out,
+            R"({"type":"log","name":"test.\"json\"","ts":1,)"
+            R"("message":"a \"quoted\" path C:\\tmp\nnext line\ttab and )"
+            R"(a bell \u0007 at the end","nan":null,"half":0.5})"
+            "\n");
+}
+
+TEST(FileSinkTest, WriteBatch) {
+  const char* path = "/tmp/ttl_test_batch.log";
+  unlink(path);
+  {
+    File sink(path);
+    Arena arena;
+    for (int64_t i = 0; i < 1000; i++) {
+      arena.begin(intern("metric"), intern("test.batch"),
+                  std::chrono::nanoseconds(i));
+      arena.add(intern("value"), i);
+    }
+    sink.publishBatch(arena);
+  }
+
+  std::ifstream in(path);
+  std::string line;
+  int64_t lines = 0;
+  while (std::getline(in, line)) {
+    const auto n = std::to_string(lines);
+    EXPECT_EQ(line, R"({"type":"metric","name":"test.batch","ts":)" + n +
+                        R"(,"value":)" + n + "}");
+    lines++;
+  }
+  EXPECT_EQ(lines, 1000);
+
+  unlink(path);
+}
+
+TEST(FileSinkTest, BufferedCoalescesWrites) {
+  const char* path = "/tmp/ttl_test_buffered.log";
+  unlink(path);
+
+  const auto lines = [&] {
+    std::ifstream in(path);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(in, line)) {
+      n++;
+    }
+    return n;
+  };
+
+  {
+    File sink(path, FileOptions{.buffer         = 1 << 20,
+                                .flush_interval = std::chrono::hours(1)});
+    Arena arena;
+    arena.begin(intern("log"), intern("test.buffered"),
+                std::chrono::nanoseconds(1));
+    arena.add(intern("message"), std::string(64 * 1024, 'x'));
+    arena.begin(intern("log"), intern("test.buffered"),
+                std::chrono::nanoseconds(2));
+    arena.add(intern("message"), std::string_view("small"));
+    sink.publishBatch(arena);
+    EXPECT_EQ(lines(), 0);
+
+    sink.flush();
+    EXPECT_EQ(lines(), 2);
+
+    sink.publishBatch(arena);
+    EXPECT_EQ(lines(), 2);
+  }
+  EXPECT_EQ(lines(), 4);
+
+  std::ifstream in(path);
+  std::string line;
+  std::getline(in, line);
+  EXPECT_EQ(line.size(), 64 * 1024 + 57);
+
+  unlink(path);
+}
+
+TEST(UringSinkTest, WritesInOrder) {
+  const char* path = "/tmp/ttl_test_uring.log";
+  unlink(path);
+  {
+    std::unique_ptr<UringFile> sink;
+    try {
+      sink = std::make_unique<UringFile>(
+          path, UringOptions{.depth = 2, .buffer = 4096});
+    } catch (const std::system_error& e) {
+      GTEST_SKIP() << "io_uring unavailable: " << e.what();
+    }
+
+    // Spans many buffers, so writes queue behind the in-flight bound.
+    Arena arena;
+    for (int64_t i = 0; i < 1000; i++) {
+      arena.begin(intern("metric"), intern("test.uring"),
+                  std::chrono::nanoseconds(i));
+      arena.add(intern("value"), i);
+    }
+    sink->publishBatch(arena);
+    sink->flush();
+    EXPECT_EQ(sink->errors(), 0);
+  }
+
+  std::ifstream in(path);
+  std::string line;
+  int64_t lines = 0;
+  while (std::getline(in, line)) {
+    const auto n = std::to_string(lines);
+    EXPECT_EQ(line, R"({"type":"metric","name":"test.uring","ts":)" + n +
+                        R"(,"value":)" + n + "}");
+    lines++;
+  }
+  EXPECT_EQ(lines, 1000);
+
+  unlink(path);
+}
+
+TEST(FileSinkTest, RotatesBySize) {
+  const std::filesystem::path dir = "/tmp/ttl_test_rotate";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  const auto path = (dir / "out.log").string();
+
+  {
+    File sink(path, FileOptions{.rotate_bytes = 4096, .retain = 3});
+    Arena arena;
+    for (int64_t i = 0; i < 100; i++) {
+      arena.clear();
+      arena.begin(intern("metric"), intern("test.rotate"),
+                  std::chrono::nanoseconds(i));
+      arena.add(intern("message"), std::string(200, 'x'));
+      sink.publishBatch(arena);
+      // A full segment only rotates once the next one is prepared; keep
+      // retrying until the live segment is back under the limit.
+      const auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      std::error_code ec;
+      while ((std::filesystem::file_size(path, ec) >= 4096 || ec) &&
+             std::chrono::steady_clock::now() < deadline) {
+        sink.flush();
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  size_t segments = 0;
+  for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+    const auto name = entry.path().filename().string();
+    EXPECT_NE(name, "out.log.next");
+    if (name == "out.log") {
+      continue;
+    }
+    segments++;
+    // Completed segments are trimmed back to their contents.
+    EXPECT_GE(entry.file_size(), 4096);
+    EXPECT_LT(entry.file_size(), 4096 + 512);
+  }
+  EXPECT_EQ(segments, 3);
+  EXPECT_TRUE(std::filesystem::exists(path));
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST(FileSinkTest, RotationRecoversFromFailedPrepare) {
+  const std::filesystem::path dir = "/tmp/ttl_test_rotate_retry";
+  std::filesystem::remove_all(dir);
+  // A directory in the way makes opening the next segment fail.
+  std::filesystem::create_directories(dir / "out.log.next");
+  const auto path = (dir / "out.log").string();
+
+  {
+    File sink(path, FileOptions{.rotate_bytes = 256});
+    Arena arena;
+    arena.begin(intern("metric"), intern("test.rotate"),
+                std::chrono::nanoseconds(0));
+    arena.add(intern("message"), std::string(300, 'x'));
+    sink.publishBatch(arena);
+
+    const auto waitFor = [](const auto& done) {
+      const auto deadline =
+          std::chrono::steady_clock::now() + std::chrono::seconds(10);
+      while (!done() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+      return done();
+    };
+    const auto completed = [&] {
+      size_t n = 0;
+      for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        const auto name = entry.path().filename().string();
+        n += name != "out.log" && name != "out.log.next" ? 1 : 0;
+      }
+      return n;
+    };
+    EXPECT_TRUE(waitFor([&] { return sink.rotateErrors() > 0; }));
+    sink.flush();
+    EXPECT_EQ(completed(), 0);
+
+    std::filesystem::remove(dir / "out.log.next");
+    EXPECT_TRUE(waitFor([&] {
+      sink.flush();
+      return completed() == 1;
+    }));
+  }
+
+  std::filesystem::remove_all(dir);
+}
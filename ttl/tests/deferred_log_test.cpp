@@ -0,0 +1,180 @@
+#include "deferred_log.hpp"
+#include <gtest/gtest.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "runtime.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+
+namespace {
+class MockSink : public ISink {
+ public:
+  explicit MockSink(std::shared_ptr<std::vector<Event>> events)
+      : events_(std::move(events)) {}
+
+  void publish(Event&& event) override {
+    std::unique_lock lock(mutex_);
+    events_->push_back(std::move(event));
+  }
+
+  void publishBatch(const Arena& arena) override {
+    std::unique_lock lock(mutex_);
+    for (const auto& record : arena.records()) {
+      events_->push_back(arena.toEvent(record));
+    }
+  }
+
+ private:
+  std::mutex mutex_;
+  std::shared_ptr<std::vector<Event>> events_;
+};
+
+template <typename... Args>
+std::string formatArgs(std::string_view format, const Args&... args) {
+  std::vector<std::byte> buf((0 + ... + deferred::argSize(args)));
+  // Unused when the pack is empty.
+  [[maybe_unused]] std::byte* p = buf.data();
+  ((p = deferred::putArg(p, args)), ...);
+  std::string out;
+  EXPECT_TRUE(deferred::format(out, format, buf));
+  return out;
+}
+
+std::vector<std::string> messages(const std::vector<Event>& events) {
+  std::vector<std::string> out;
+  for (const auto& event : events) {
+    if (event.name != "logf") {
+      continue;
+    }
+    for (const auto& field : event.fields) {
+      if (field.key == "message") {
+        out.push_back(std::get<std::string>(field.value));
+      }
+    }
+  }
+  return out;
+}
+}  // namespace
+
+TEST(DeferredLogTest, FormatsArguments) {
+  EXPECT_EQ(formatArgs("plain"), "plain");
+  EXPECT_EQ(formatArgs("{} {} {} {} {} {}", -3, 7U, 1.5, true, 'x', "str"),
+            "-3 7 1.5 true x str");
+  EXPECT_EQ(formatArgs("{{}} {}", std::string("s")), "{} s");
+  EXPECT_EQ(formatArgs("{} and {}", 1), "1 and {}");
+}
+
+TEST(DeferredLogTest, CapturesIntoRecords) {
+  static const LogSite site{Warn, "request {} took {}ms", __FILE__, __LINE__};
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+    DeferredLogger logger{rt};
+    logger.log(site, "/a", 12);
+    std::thread([&] { logger.log(site, "/b", 3.25); }).join();
+  }
+
+  auto got = messages(*events);
+  std::ranges::sort(got);
+  EXPECT_EQ(got, (std::vector<std::string>{"request /a took 12ms",
+                                           "request /b took 3.25ms"}));
+  for (const auto& event : *events) {
+    if (event.name == "logf") {
+      EXPECT_EQ(event.type, "log");
+      EXPECT_EQ(std::get<std::string>(event.fields[0].value), "Warn");
+    }
+  }
+}
+
+TEST(DeferredLogTest, DropsWhenRingIsFull) {
+  static const LogSite site{Info, "{}", __FILE__, __LINE__};
+  auto events = std::make_shared<std::vector<Event>>();
+  size_t dropped = 0;
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events),
+             RuntimeOptions{.interval = std::chrono::milliseconds(60000)});
+    DeferredLogger logger{rt, DeferredLogOptions{.buffer = 256, .path = {}}};
+    for (int i = 0; i < 100; ++i) {
+      logger.log(site, i);
+    }
+    dropped = logger.dropped();
+  }
+
+  EXPECT_GT(dropped, 0U);
+  EXPECT_EQ(messages(*events).size() + dropped, 100U);
+}
+
+TEST(DeferredLogTest, WritesDecodableBinaryLog) {
+  static const LogSite first{Info, "user {} logged in", "a.cpp", 10};
+  static const LogSite second{Error, "{} failed: {}", "b.cpp", 20};
+  const auto path = std::filesystem::temp_directory_path() /
+                    ("ttl_deferred_" + std::to_string(::getpid()) + ".log");
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+    DeferredLogger logger{rt, DeferredLogOptions{.path = path.string()}};
+    logger.log(first, "ann");
+    logger.log(second, "open", -2);
+    logger.log(first, "bob");
+  }
+  EXPECT_TRUE(messages(*events).empty());
+
+  std::ifstream in(path, std::ios::binary);
+  const std::string log{std::istreambuf_iterator<char>(in),
+                        std::istreambuf_iterator<char>()};
+  std::filesystem::remove(path);
+
+  std::string out;
+  ASSERT_TRUE(deferred::decode(log, out));
+  std::vector<std::string> lines;
+  for (size_t pos = 0, end = 0; (end = out.find('\n', pos)) != std::string::npos;
+       pos = end + 1) {
+    const auto line = out.substr(pos, end - pos);
+    lines.push_back(line.substr(line.find(' ') + 1));
+  }
+  EXPECT_EQ(lines, (std::vector<std::string>{"Info a.cpp:10 user ann logged in",
+                                             "Error b.cpp:20 open failed: -2",
+                                             "Info a.cpp:10 user bob logged in"}));
+
+  std::string truncated;
+  EXPECT_FALSE(deferred::decode(std::string_view(log).substr(0, log.size() - 3),
+                                truncated));
+}
+
+TEST(DeferredLogTest, DecodeHandlesHugeSiteIds) {
+  const auto u32 = [](std::string& out, uint32_t v) {
+    out.append(reinterpret_cast<const char*>(&v), sizeof(v));
+  };
+  std::string log(deferred::kMagic);
+  log.push_back(static_cast<char>(deferred::kVersion));
+  // A site under an id near the top of the range, then an entry for an
+  // id that was never defined.
+  log.push_back('S');
+  u32(log, 0xfffffff0);
+  log.push_back(static_cast<char>(Info));
+  u32(log, 1);
+  u32(log, 1);
+  log.append("f");
+  u32(log, 1);
+  log.append("x");
+  log.push_back('E');
+  u32(log, 12);
+  u32(log, 7);
+  log.append(8, '\0');
+
+  std::string out;
+  EXPECT_FALSE(deferred::decode(log, out));
+}
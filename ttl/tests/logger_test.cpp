@@ -1,8 +1,16 @@
 #include "logger.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
 #include <memory>
 #include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
 #include <vector>
+#include "json.hpp"
 #include "runtime.hpp"
 #include "types.hpp"
 
@@ -18,6 +26,13 @@ class MockSink : public ISink {
     events_->push_back(std::move(event));
   }
 
+  void publishBatch(const Arena& arena) override {
+    std::unique_lock lock(mutex_);
+    for (const auto& record : arena.records()) {
+      events_->push_back(arena.toEvent(record));
+    }
+  }
+
   [[nodiscard]] std::vector<Event> events() const {
     std::vector<Event> copy;
     {
@@ -123,3 +138,370 @@ TEST(LoggerTest, StreamOperator) {
 
   EXPECT_TRUE(found);
 }
+
+namespace {
+std::vector<std::string> messages(const std::vector<Event>& events) {
+  std::vector<std::string> out;
+  for (const auto& event : events) {
+    if (event.type != "log") {
+      continue;
+    }
+    for (const auto& field : event.fields) {
+      if (field.key == "message") {
+        out.push_back(std::get<std::string>(field.value));
+      }
+    }
+  }
+  return out;
+}
+
+// Logs "0".."n-1" faster than a 60s capture interval drains them.
+std::vector<std::string> overflow(LoggerOptions options, int n,
+                                  size_t& dropped) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events),
+             RuntimeOptions{.interval = std::chrono::milliseconds(60000)});
+    Logger logger{rt, options};
+    for (int i = 0; i < n; ++i) {
+      logger.log(Info, std::to_string(i));
+    }
+    dropped = logger.dropped();
+  }
+  return messages(*events);
+}
+}  // namespace
+
+TEST(LoggerTest, DropNewestKeepsEarliest) {
+  size_t dropped = 0;
+  const auto got = overflow({.buffer = 256, .drop = DropPolicy::Newest}, 100,
+                            dropped);
+  ASSERT_FALSE(got.empty());
+  EXPECT_GT(dropped, 0U);
+  EXPECT_EQ(got.size() + dropped, 100U);
+  for (size_t i = 0; i < got.size(); ++i) {
+    EXPECT_EQ(got[i], std::to_string(i));
+  }
+}
+
+TEST(LoggerTest, DropOldestKeepsLatest) {
+  size_t dropped = 0;
+  const auto got = overflow({.buffer = 256, .drop = DropPolicy::Oldest}, 100,
+                            dropped);
+  ASSERT_FALSE(got.empty());
+  EXPECT_GT(dropped, 0U);
+  EXPECT_EQ(got.size() + dropped, 100U);
+  for (size_t i = 0; i < got.size(); ++i) {
+    EXPECT_EQ(got[i], std::to_string(100 - got.size() + i));
+  }
+}
+
+TEST(LoggerTest, DropsOversizedMessages) {
+  size_t dropped = 0;
+  auto events    = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+    Logger logger{rt, {.buffer = 128}};
+    logger.log(Info, std::string(100, 'x'));
+    logger.log(Info, "fits");
+    dropped = logger.dropped();
+  }
+  EXPECT_EQ(dropped, 1U);
+  EXPECT_EQ(messages(*events), (std::vector<std::string>{"fits"}));
+}
+
+TEST(LoggerTest, LargestEntryFitsAtPaddedOffset) {
+  // 256-byte rings take entries of up to 128 bytes with framing (a 103
+  // byte message); two 85-byte entries leave the next one needing
+  // padding at offset 170.
+  const std::string large(103, 'l');
+  for (const auto drop : {DropPolicy::Oldest, DropPolicy::Block}) {
+    auto events    = std::make_shared<std::vector<Event>>();
+    size_t dropped = 0;
+    {
+      auto rt = std::make_shared<detail::Runtime>();
+      rt->init(std::make_unique<MockSink>(events),
+               RuntimeOptions{.interval = std::chrono::milliseconds(1)});
+      Logger logger{rt, {.buffer = 256, .drop = drop}};
+      logger.log(Info, std::string(60, 'a'));
+      logger.log(Info, std::string(60, 'b'));
+      logger.log(Info, large);
+      logger.log(Info, std::string(104, 'x'));
+      dropped = logger.dropped();
+    }
+    const auto got = messages(*events);
+    ASSERT_FALSE(got.empty());
+    EXPECT_EQ(got.back(), large);
+    EXPECT_EQ(got.size() + dropped, 4U);
+  }
+}
+
+TEST(LoggerTest, BlockingThreadsLoseNothing) {
+  constexpr int kThreads = 4;
+  constexpr int kPerThread = 2000;
+  auto events = std::make_shared<std::vector<Event>>();
+  size_t dropped = 0;
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events),
+             RuntimeOptions{.interval = std::chrono::milliseconds(1)});
+    Logger logger{rt, {.buffer = 512, .drop = DropPolicy::Block}};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+      threads.emplace_back([&, t] {
+        for (int i = 0; i < kPerThread; ++i) {
+          logger.log(Info, std::to_string(t) + ":" + std::to_string(i));
+        }
+      });
+    }
+    for (auto& thread : threads) {
+      thread.join();
+    }
+    dropped = logger.dropped();
+  }
+
+  EXPECT_EQ(dropped, 0U);
+  const auto got = messages(*events);
+  ASSERT_EQ(got.size(), size_t{kThreads * kPerThread});
+  // Each thread's entries arrive in order.
+  std::vector<int> next(kThreads, 0);
+  for (const auto& message : got) {
+    const auto colon = message.find(':');
+    const int t      = std::stoi(message.substr(0, colon));
+    EXPECT_EQ(std::stoi(message.substr(colon + 1)), next[t]++);
+  }
+}
+
+namespace {
+struct Counted {
+  int* formatted;
+};
+
+std::ostream& operator<<(std::ostream& os, const Counted& c) {
+  ++*c.formatted;
+  return os << "counted";
+}
+}  // namespace
+
+TEST(LoggerTest, HierarchicalModuleLevels) {
+  auto& http = logModule("lt.net.http");
+  auto& tls  = logModule("lt.net.tls");
+  EXPECT_EQ(http.name(), "lt.net.http");
+  EXPECT_EQ(http.parent(), &logModule("lt.net"));
+  EXPECT_EQ(&logModule("lt.net.http"), &http);
+
+  setLogLevel("lt.net", Warn);
+  EXPECT_EQ(http.level(), Warn);
+  EXPECT_FALSE(tls.enabled(Info));
+
+  setLogLevel("lt.net.http", Debug);
+  setLogLevel("lt.net", Error);
+  EXPECT_EQ(http.level(), Debug);
+  EXPECT_EQ(tls.level(), Error);
+
+  clearLogLevel("lt.net.http");
+  EXPECT_EQ(http.level(), Error);
+  // Modules created later inherit too.
+  EXPECT_EQ(logModule("lt.net.http.h2").level(), Error);
+
+  setLogLevels("lt=Info,lt.net=Critical");
+  EXPECT_EQ(logModule("lt").level(), Info);
+  EXPECT_EQ(tls.level(), Critical);
+  EXPECT_THROW(setLogLevels("lt.net=Loud"), std::invalid_argument);
+
+  clearLogLevel("lt.net");
+  clearLogLevel("lt");
+  EXPECT_EQ(http.level(), Trace);
+}
+
+TEST(LoggerTest, NamedLoggerSkipsDisabledLevels) {
+  auto events   = std::make_shared<std::vector<Event>>();
+  int formatted = 0;
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+    Logger root{rt};
+    Logger db = root.named("lt.db");
+    setLogLevel("lt.db", Warn);
+    LogStream(db, Info) << Counted{&formatted};
+    LogStream(db, Error) << Counted{&formatted};
+    LogStream(root, Info) << Counted{&formatted};
+    clearLogLevel("lt.db");
+  }
+
+  EXPECT_EQ(formatted, 2);
+  std::vector<std::string> modules;
+  for (const auto& event : *events) {
+    if (event.type != "log") {
+      continue;
+    }
+    std::string module;
+    for (const auto& field : event.fields) {
+      if (field.key == "module") {
+        module = std::get<std::string>(field.value);
+      }
+    }
+    modules.push_back(module);
+  }
+  std::ranges::sort(modules);
+  EXPECT_EQ(modules, (std::vector<std::string>{"", "lt.db"}));
+}
+
+TEST(LoggerTest, CallSitesFollowLevelChanges) {
+  int formatted = 0;
+  const auto site = [&] { TTL_LOGM("lt.gate", Debug) << Counted{&formatted}; };
+
+  site();
+  EXPECT_EQ(formatted, 1);
+
+  setLogLevel("lt.gate", Info);
+  site();
+  site();
+  EXPECT_EQ(formatted, 1);
+
+  // Changing another module leaves this site's decision intact.
+  setLogLevel("lt.other", Critical);
+  site();
+  EXPECT_EQ(formatted, 1);
+
+  setLogLevel("lt.gate", Debug);
+  site();
+  EXPECT_EQ(formatted, 2);
+
+  clearLogLevel("lt.gate");
+  clearLogLevel("lt.other");
+}
+
+TEST(LoggerTest, EveryNLogsFirstOfEachN) {
+  int formatted = 0;
+  for (int i = 0; i < 10; ++i) {
+    TTL_LOGM_EVERY_N("lt.every", Info, 3) << Counted{&formatted};
+  }
+  EXPECT_EQ(formatted, 4);
+}
+
+TEST(LoggerTest, EveryZeroLogsEveryCall) {
+  int formatted = 0;
+  for (int i = 0; i < 5; ++i) {
+    TTL_LOGM_EVERY_N("lt.every", Info, 0) << Counted{&formatted};
+  }
+  EXPECT_EQ(formatted, 5);
+}
+
+TEST(LoggerTest, EveryIntervalLogsOnce) {
+  int formatted = 0;
+  const auto site = [&] {
+    TTL_LOGM_EVERY("lt.every", Info, std::chrono::hours(1))
+        << Counted{&formatted};
+  };
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.emplace_back([&] {
+      for (int i = 0; i < 100; ++i) {
+        site();
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+  EXPECT_EQ(formatted, 1);
+}
+
+TEST(LoggerTest, CoalescesRepeatedMessages) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events),
+             RuntimeOptions{.interval = std::chrono::milliseconds(60000)});
+    Logger logger{rt};
+    for (int i = 0; i < 500; ++i) {
+      logger.log(Error, "upstream down");
+    }
+    logger.log(Error, "recovered");
+    logger.log(Warn, "upstream down");
+    logger.log(Warn, "upstream down");
+  }
+
+  std::vector<std::pair<std::string, int64_t>> got;
+  for (const auto& event : *events) {
+    if (event.type != "log") {
+      continue;
+    }
+    std::string message;
+    int64_t repeat = 1;
+    for (const auto& field : event.fields) {
+      if (field.key == "message") {
+        message = std::get<std::string>(field.value);
+      } else if (field.key == "repeat") {
+        repeat = std::get<int64_t>(field.value);
+      }
+    }
+    got.emplace_back(message, repeat);
+  }
+  EXPECT_EQ(got, (std::vector<std::pair<std::string, int64_t>>{
+                     {"upstream down", 500},
+                     {"recovered", 1},
+                     {"upstream down", 2}}));
+}
+
+TEST(LoggerTest, StructuredFields) {
+  auto events = std::make_shared<std::vector<Event>>();
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<MockSink>(events));
+    Logger logger{rt};
+    const std::string path = "/login";
+    logger.log(Info, "request",
+               {kv<"path">(path), kv<"status">(200), kv<"ms">(1.5),
+                kv<"cached">(true)});
+  }
+
+  const Event* request = nullptr;
+  for (const auto& event : *events) {
+    if (event.type == "log") {
+      request = &event;
+    }
+  }
+  ASSERT_NE(request, nullptr);
+  ASSERT_EQ(request->fields.size(), 6U);
+  EXPECT_EQ(std::get<std::string>(request->fields[1].value), "request");
+  EXPECT_EQ(request->fields[2].key, "path");
+  EXPECT_EQ(std::get<std::string>(request->fields[2].value), "/login");
+  EXPECT_EQ(request->fields[3].key, "status");
+  EXPECT_EQ(std::get<int64_t>(request->fields[3].value), 200);
+  EXPECT_EQ(request->fields[4].key, "ms");
+  EXPECT_EQ(std::get<double>(request->fields[4].value), 1.5);
+  EXPECT_EQ(std::get<int64_t>(request->fields[5].value), 1);
+}
+
+TEST(LoggerTest, StructuredMacroSkipsDisabledLevels) {
+  int evaluated = 0;
+  const auto count = [&] { return ++evaluated; };
+  setLogLevel("lt.kv", Warn);
+  TTL_LOGMKV("lt.kv", Info, "skipped", kv<"n">(count()));
+  TTL_LOGMKV("lt.kv", Error, "kept", kv<"n">(count()));
+  clearLogLevel("lt.kv");
+  EXPECT_EQ(evaluated, 1);
+}
+
+TEST(LoggerTest, StructuredFieldsReachJsonTyped) {
+  struct JsonSink : ISink {
+    explicit JsonSink(std::string& out) : out(out) {}
+    void publish(Event&& /*event*/) override {}
+    void publishBatch(const Arena& arena) override { encodeJson(out, arena); }
+    std::string& out;
+  };
+
+  std::string json;
+  {
+    auto rt = std::make_shared<detail::Runtime>();
+    rt->init(std::make_unique<JsonSink>(json));
+    Logger logger{rt};
+    logger.log(Warn, "slow", {kv<"status">(503), kv<"peer">("db-1")});
+  }
+  EXPECT_NE(json.find(R"("status":503)"), std::string::npos) << json;
+  EXPECT_NE(json.find(R"("peer":"db-1")"), std::string::npos) << json;
+}
@@ -0,0 +1,129 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <util.hpp>
+#include "prometheus_sink.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+using namespace std::chrono_literals;
+
+namespace {
+std::string get(const std::string& address, std::string_view path) {
+  const auto& parsed = bits::parseAddress(address);
+  const int fd       = bits::makeSockTcp();
+  EXPECT_EQ(bits::sockConnect(fd, parsed->second, parsed->first), 0);
+
+  const std::string request =
+      "GET " + std::string(path) + " HTTP/1.1\r\nHost: test\r\n\r\n";
+  EXPECT_EQ(::send(fd, request.data(), request.size(), 0),
+            static_cast<ssize_t>(request.size()));
+
+  std::string response;
+  char buf[4096];
+  ssize_t n = 0;
+  while ((n = ::recv(fd, buf, sizeof(buf), 0)) > 0) {
+    response.append(buf, static_cast<size_t>(n));
+  }
+  ::close(fd);
+  return response;
+}
+
+std::string body(const std::string& response) {
+  const auto& pos = response.find("\r\n\r\n");
+  return pos == std::string::npos ? std::string{} : response.substr(pos + 4);
+}
+
+Arena summary(int64_t count, double p99) {
+  Arena arena;
+  arena.begin(intern("summary"), intern("test.latency"),
+              std::chrono::nanoseconds(1));
+  arena.add(intern("count"), count);
+  arena.add(intern("sum"), 12.5);
+  arena.add(intern("max"), 9.0);
+  arena.add(intern("p99"), p99);
+  return arena;
+}
+}  // namespace
+
+TEST(PrometheusSinkTest, RendersSummariesAndGauges) {
+  PrometheusSink sink("127.0.0.1:0", PrometheusOptions{.interval = 0ms});
+
+  auto arena = summary(3, 8.5);
+  arena.begin(intern("metric"), intern("test.depth"),
+              std::chrono::nanoseconds(2));
+  arena.add(intern("value"), 4.0);
+  arena.add(intern("dropped"), int64_t{0});
+  arena.begin(intern("log"), intern("test.log"), std::chrono::nanoseconds(3));
+  arena.add(intern("message"), std::string_view("ignored"));
+  sink.publishBatch(arena);
+
+  const auto& response = get(sink.address(), "/metrics");
+  EXPECT_TRUE(response.starts_with("HTTP/1.1 200 OK\r\n"));
+  EXPECT_EQ(body(response),
+            "# TYPE test_latency summary\n"
+            "test_latency{quantile=\"0.99\"} 8.5\n"
+            "test_latency_count 3\n"
+            "test_latency_sum 12.5\n"
+            "# TYPE test_latency_max gauge\n"
+            "test_latency_max 9\n"
+            "# TYPE test_depth gauge\n"
+            "test_depth 4\n"
+            "# TYPE test_depth_dropped gauge\n"
+            "test_depth_dropped 0\n");
+  EXPECT_EQ(sink.scrapes(), 1U);
+}
+
+TEST(PrometheusSinkTest, ServesCachedPageWithinInterval) {
+  PrometheusSink sink("127.0.0.1:0", PrometheusOptions{.interval = 1h});
+
+  sink.publishBatch(summary(1, 1.0));
+  const auto& first = body(get(sink.address(), "/metrics"));
+  EXPECT_NE(first.find("test_latency_count 1\n"), std::string::npos);
+
+  sink.publishBatch(summary(2, 2.0));
+  EXPECT_EQ(body(get(sink.address(), "/metrics")), first);
+  EXPECT_EQ(sink.renders(), 1U);
+  EXPECT_EQ(sink.scrapes(), 2U);
+}
+
+TEST(PrometheusSinkTest, SummaryCountAndSumAreCumulative) {
+  PrometheusSink sink("127.0.0.1:0", PrometheusOptions{.interval = 0ms});
+
+  sink.publishBatch(summary(3, 8.5));
+  const auto& first = body(get(sink.address(), "/metrics"));
+  EXPECT_NE(first.find("test_latency_count 3\n"), std::string::npos);
+  EXPECT_NE(first.find("test_latency_sum 12.5\n"), std::string::npos);
+
+  // The next window alone counts fewer samples; the export must not drop.
+  sink.publishBatch(summary(2, 4.0));
+  const auto& second = body(get(sink.address(), "/metrics"));
+  EXPECT_NE(second.find("test_latency_count 5\n"), std::string::npos);
+  EXPECT_NE(second.find("test_latency_sum 25\n"), std::string::npos);
+  EXPECT_NE(second.find("test_latency{quantile=\"0.99\"} 4\n"),
+            std::string::npos);
+}
+
+TEST(PrometheusSinkTest, QuantileLabelsAreRounded) {
+  PrometheusSink sink("127.0.0.1:0", PrometheusOptions{.interval = 0ms});
+
+  Arena arena;
+  arena.begin(intern("summary"), intern("test.tail"),
+              std::chrono::nanoseconds(1));
+  arena.add(intern("count"), 1);
+  arena.add(intern("p99.9"), 7.0);
+  sink.publishBatch(arena);
+
+  const auto& page = body(get(sink.address(), "/metrics"));
+  EXPECT_NE(page.find("test_tail{quantile=\"0.999\"} 7\n"), std::string::npos)
+      << page;
+}
+
+TEST(PrometheusSinkTest, UnknownPathIsNotFound) {
+  PrometheusSink sink("127.0.0.1:0");
+  EXPECT_TRUE(get(sink.address(), "/").starts_with("HTTP/1.1 404"));
+  EXPECT_EQ(sink.scrapes(), 0U);
+}
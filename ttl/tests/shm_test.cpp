@@ -0,0 +1,149 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include "shm_reader.hpp"
+#include "shm_ring.hpp"
+#include "shm_sink.hpp"
+#include "symbols.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+
+namespace {
+std::string ringName(std::string_view test) {
+  return std::string("ttl_test_") + std::string(test) + "_" +
+         std::to_string(::getpid());
+}
+
+void publish(ShmSink& sink, int64_t from, int64_t n) {
+  Arena arena;
+  for (int64_t i = from; i < from + n; i++) {
+    arena.begin(intern("metric"), intern("test.shm"),
+                std::chrono::nanoseconds(i));
+    arena.add(intern("value"), i);
+  }
+  sink.publishBatch(arena);
+}
+
+std::string line(int64_t i) {
+  const auto n = std::to_string(i);
+  return R"({"type":"metric","name":"test.shm","ts":)" + n + R"(,"value":)" +
+         n + "}\n";
+}
+}  // namespace
+
+TEST(ShmTest, ReaderSeesMessagesAfterAttach) {
+  const auto name = ringName("attach");
+  ShmSink sink(name, ShmOptions{.segment = 4096, .segments = 4});
+  publish(sink, 0, 5);
+
+  ShmReader reader(name);
+  std::string message;
+  EXPECT_FALSE(reader.next(message));
+
+  publish(sink, 5, 100);
+  for (int64_t i = 5; i < 105; i++) {
+    ASSERT_TRUE(reader.next(message));
+    EXPECT_EQ(message, line(i));
+  }
+  EXPECT_FALSE(reader.next(message));
+  EXPECT_EQ(reader.overruns(), 0);
+}
+
+TEST(ShmTest, FromOldest) {
+  const auto name = ringName("oldest");
+  ShmSink sink(name, ShmOptions{.segment = 4096, .segments = 4});
+  publish(sink, 0, 10);
+
+  ShmReader reader(name, true);
+  std::string message;
+  ASSERT_TRUE(reader.next(message));
+  EXPECT_EQ(message, line(0));
+}
+
+TEST(ShmTest, OverrunIsDetected) {
+  const auto name = ringName("overrun");
+  ShmSink sink(name, ShmOptions{.segment = 1024, .segments = 4});
+  ShmReader reader(name);
+
+  // Far more than the 4 KiB ring holds.
+  publish(sink, 0, 1000);
+
+  std::string message;
+  int64_t last = -1;
+  while (reader.next(message)) {
+    const auto pos = message.find("\"value\":") + 8;
+    const int64_t v = std::stoll(message.substr(pos));
+    EXPECT_GT(v, last);
+    last = v;
+  }
+  EXPECT_EQ(last, 999);
+  EXPECT_EQ(reader.overruns(), 1);
+}
+
+TEST(ShmTest, ConcurrentReaderNeverSeesTornMessages) {
+  const auto name = ringName("concurrent");
+  ShmSink sink(name, ShmOptions{.segment = 1024, .segments = 4});
+  ShmReader reader(name);
+
+  std::atomic<bool> done{false};
+  std::thread writer([&] {
+    for (int64_t i = 0; i < 20000; i += 10) {
+      publish(sink, i, 10);
+    }
+    done = true;
+  });
+
+  std::string message;
+  int64_t last = -1;
+  while (true) {
+    const bool finished = done.load();
+    if (!reader.next(message)) {
+      if (finished) {
+        break;
+      }
+      continue;
+    }
+    const auto pos  = message.find("\"value\":") + 8;
+    const int64_t v = std::stoll(message.substr(pos));
+    ASSERT_EQ(message, line(v));
+    EXPECT_GT(v, last);
+    last = v;
+  }
+  writer.join();
+  EXPECT_EQ(last, 19999);
+}
+
+TEST(ShmTest, CorruptHeaderThrows) {
+  const auto name = ringName("corrupt");
+  ShmSink sink(name, ShmOptions{.segment = 4096, .segments = 4});
+
+  const int fd = ::shm_open(shm::shmName(name).c_str(), O_RDWR, 0);
+  ASSERT_GE(fd, 0);
+  void* base = ::mmap(nullptr, shm::kPage, PROT_READ | PROT_WRITE, MAP_SHARED,
+                      fd, 0);
+  ::close(fd);
+  ASSERT_NE(base, MAP_FAILED);
+  auto* h = static_cast<shm::Header*>(base);
+
+  h->segment_size = 0;
+  EXPECT_THROW(ShmReader{name}, std::runtime_error);
+
+  // Would wrap mappingSize() around to something small.
+  h->segments     = UINT32_MAX;
+  h->segment_size = UINT32_MAX;
+  EXPECT_THROW(ShmReader{name}, std::runtime_error);
+
+  ::munmap(base, shm::kPage);
+}
+
+TEST(ShmTest, MissingRingThrows) {
+  EXPECT_THROW(ShmReader("ttl_test_does_not_exist"), std::system_error);
+}
@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <util.hpp>
+#include "symbols.hpp"
+#include "tcp_sink.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+
+namespace {
+class Listener {
+ public:
+  Listener() : fd_(bits::makeSockTcp()) {
+    bits::setSockOptShared(fd_);
+    EXPECT_EQ(bits::sockBind(fd_, 0, "127.0.0.1"), 0);
+    EXPECT_EQ(bits::sockListen(fd_), 0);
+  }
+
+  ~Listener() { ::close(fd_); }
+
+  [[nodiscard]] std::string address() const {
+    return *bits::getSockOptHostPort(fd_);
+  }
+
+  [[nodiscard]] int accept() const { return ::accept(fd_, nullptr, nullptr); }
+
+ private:
+  int fd_;
+};
+
+bool readAll(int fd, char* p, size_t n) {
+  while (n != 0) {
+    const ssize_t r = ::recv(fd, p, n, 0);
+    if (r <= 0) {
+      return false;
+    }
+    p += r;
+    n -= static_cast<size_t>(r);
+  }
+  return true;
+}
+
+std::string readFrame(int fd) {
+  uint32_t len = 0;
+  if (!readAll(fd, reinterpret_cast<char*>(&len), sizeof(len))) {
+    return {};
+  }
+  std::string payload(bits::fromNetwork(len), '\0');
+  readAll(fd, payload.data(), payload.size());
+  return payload;
+}
+
+Arena batch(int64_t from, int64_t n) {
+  Arena arena;
+  for (int64_t i = from; i < from + n; i++) {
+    arena.begin(intern("metric"), intern("test.tcp"),
+                std::chrono::nanoseconds(i));
+    arena.add(intern("value"), i);
+  }
+  return arena;
+}
+}  // namespace
+
+TEST(TcpSinkTest, FramesBatches) {
+  Listener listener;
+  TcpSink sink(listener.address());
+  sink.publishBatch(batch(0, 2));
+  sink.publishBatch(batch(2, 1));
+
+  const int conn = listener.accept();
+  ASSERT_GE(conn, 0);
+  EXPECT_EQ(readFrame(conn),
+            R"({"type":"metric","name":"test.tcp","ts":0,"value":0})"
+            "\n"
+            R"({"type":"metric","name":"test.tcp","ts":1,"value":1})"
+            "\n");
+  EXPECT_EQ(readFrame(conn),
+            R"({"type":"metric","name":"test.tcp","ts":2,"value":2})"
+            "\n");
+  ::close(conn);
+}
+
+TEST(TcpSinkTest, Reconnects) {
+  Listener listener;
+  TcpSink sink(listener.address(),
+               TcpOptions{.backoff_min = std::chrono::milliseconds(10)});
+  sink.publishBatch(batch(0, 1));
+
+  int conn = listener.accept();
+  ASSERT_GE(conn, 0);
+  EXPECT_FALSE(readFrame(conn).empty());
+  ::close(conn);
+
+  // The sink notices the close, backs off and connects again.
+  std::this_thread::sleep_for(std::chrono::milliseconds(50));
+  sink.publishBatch(batch(1, 1));
+  conn = listener.accept();
+  ASSERT_GE(conn, 0);
+  EXPECT_EQ(readFrame(conn),
+            R"({"type":"metric","name":"test.tcp","ts":1,"value":1})"
+            "\n");
+  EXPECT_GE(sink.connects(), 2);
+  ::close(conn);
+}
+
+TEST(TcpSinkTest, RejectsHostNames) {
+  EXPECT_THROW(TcpSink("localhost:9000"), std::invalid_argument);
+  EXPECT_THROW(TcpSink("127.0.0.1"), std::invalid_argument);
+}
+
+TEST(TcpSinkTest, DropsOldestWithoutBlocking) {
+  std::string address;
+  {
+    Listener gone;
+    address = gone.address();
+  }
+
+  TcpSink sink(address, TcpOptions{.queue  = 1024,
+                                   .linger = std::chrono::milliseconds(0)});
+  const auto start = std::chrono::steady_clock::now();
+  for (int64_t i = 0; i < 1000; i++) {
+    sink.publishBatch(batch(i, 1));
+  }
+  EXPECT_LT(std::chrono::steady_clock::now() - start,
+            std::chrono::milliseconds(500));
+  EXPECT_GT(sink.dropped(), 900);
+}
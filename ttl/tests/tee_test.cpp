@@ -0,0 +1,156 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "symbols.hpp"
+#include "tee_sink.hpp"
+#include "types.hpp"
+
+using namespace bits::ttl;
+using namespace std::chrono_literals;
+
+namespace {
+struct Received {
+  std::mutex mutex;
+  std::vector<int64_t> values;
+  std::atomic<bool> flushed{false};
+};
+
+// Records the `value` of every record, optionally stalling until released.
+class MockSink : public ISink {
+ public:
+  explicit MockSink(std::shared_ptr<Received> received,
+                    std::shared_ptr<std::atomic<bool>> gate = nullptr)
+      : received_(std::move(received)), gate_(std::move(gate)) {}
+
+  void publish(Event&& /*event*/) override {}
+
+  void publishBatch(const Arena& arena) override {
+    while (gate_ && !gate_->load()) {
+      std::this_thread::sleep_for(1ms);
+    }
+    std::unique_lock lock(received_->mutex);
+    for (const auto& record : arena.records()) {
+      received_->values.push_back(arena.fields(record)[0].i);
+    }
+  }
+
+  void flush() override { received_->flushed = true; }
+
+ private:
+  std::shared_ptr<Received> received_;
+  std::shared_ptr<std::atomic<bool>> gate_;
+};
+
+Arena batch(int64_t value) {
+  Arena arena;
+  arena.begin(intern("metric"), intern("test.tee"),
+              std::chrono::nanoseconds(value));
+  arena.add(intern("value"), value);
+  return arena;
+}
+}  // namespace
+
+TEST(TeeSinkTest, FansOutToEverySink) {
+  auto a = std::make_shared<Received>();
+  auto b = std::make_shared<Received>();
+  std::vector<TeeBranch> branches;
+  branches.push_back({.sink = std::make_unique<MockSink>(a), .options = {}});
+  branches.push_back({.sink = std::make_unique<MockSink>(b), .options = {}});
+  TeeSink tee(std::move(branches));
+
+  for (int64_t i = 0; i < 10; i++) {
+    tee.publishBatch(batch(i));
+  }
+  tee.flush();
+
+  const std::vector<int64_t> expected{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  EXPECT_EQ(a->values, expected);
+  EXPECT_EQ(b->values, expected);
+  EXPECT_TRUE(a->flushed);
+  EXPECT_TRUE(b->flushed);
+  EXPECT_EQ(tee.stats(0).batches, 10U);
+  EXPECT_EQ(tee.stats(1).records, 10U);
+}
+
+TEST(TeeSinkTest, SlowSinkDropsWithoutStallingOthers) {
+  auto fast = std::make_shared<Received>();
+  auto slow = std::make_shared<Received>();
+  auto gate = std::make_shared<std::atomic<bool>>(false);
+
+  std::vector<TeeBranch> branches;
+  branches.push_back(
+      {.sink    = std::make_unique<MockSink>(fast),
+       .options = {.queue = 128, .drop = DropPolicy::Block}});
+  branches.push_back(
+      {.sink    = std::make_unique<MockSink>(slow, gate),
+       .options = {.queue = 2, .drop = DropPolicy::Newest}});
+  TeeSink tee(std::move(branches));
+
+  for (int64_t i = 0; i < 100; i++) {
+    tee.publishBatch(batch(i));
+  }
+
+  // The fast sink gets everything while the slow one is still stuck.
+  for (int i = 0; i < 1000 && tee.stats(0).batches < 100; i++) {
+    std::this_thread::sleep_for(1ms);
+  }
+  EXPECT_EQ(tee.stats(0).batches, 100U);
+  EXPECT_EQ(tee.stats(1).batches, 0U);
+
+  gate->store(true);
+  tee.flush();
+
+  // At most one batch in flight plus a full queue survive.
+  EXPECT_LE(slow->values.size(), 3U);
+  EXPECT_EQ(slow->values.front(), 0);
+  EXPECT_EQ(tee.stats(1).dropped + tee.stats(1).batches, 100U);
+}
+
+TEST(TeeSinkTest, DropOldestKeepsLatest) {
+  auto slow = std::make_shared<Received>();
+  auto gate = std::make_shared<std::atomic<bool>>(false);
+
+  std::vector<TeeBranch> branches;
+  branches.push_back(
+      {.sink    = std::make_unique<MockSink>(slow, gate),
+       .options = {.queue = 2, .drop = DropPolicy::Oldest}});
+  TeeSink tee(std::move(branches));
+
+  for (int64_t i = 0; i < 50; i++) {
+    tee.publishBatch(batch(i));
+  }
+  gate->store(true);
+  tee.flush();
+
+  ASSERT_GE(slow->values.size(), 2U);
+  EXPECT_EQ(slow->values.back(), 49);
+  EXPECT_EQ(slow->values[slow->values.size() - 2], 48);
+  EXPECT_EQ(tee.stats(0).dropped + tee.stats(0).batches, 50U);
+}
+
+TEST(TeeSinkTest, BlockLosesNothing) {
+  auto slow = std::make_shared<Received>();
+  auto gate = std::make_shared<std::atomic<bool>>(false);
+
+  std::vector<TeeBranch> branches;
+  branches.push_back(
+      {.sink    = std::make_unique<MockSink>(slow, gate),
+       .options = {.queue = 1, .drop = DropPolicy::Block}});
+  TeeSink tee(std::move(branches));
+
+  std::jthread release([&] {
+    std::this_thread::sleep_for(20ms);
+    gate->store(true);
+  });
+  for (int64_t i = 0; i < 20; i++) {
+    tee.publishBatch(batch(i));
+  }
+  tee.flush();
+
+  EXPECT_EQ(slow->values.size(), 20U);
+  EXPECT_EQ(tee.stats(0).dropped, 0U);
+}
@@ -0,0 +1,105 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <chrono>
+#include <string>
+#include <util.hpp>
+#include "symbols.hpp"
+#include "types.hpp"
+#include "udp_sink.hpp"
+
+using namespace bits::ttl;
+
+namespace {
+class Receiver {
+ public:
+  Receiver() : fd_(bits::makeSockUdp()) {
+    EXPECT_EQ(bits::sockBind(fd_, 0, "127.0.0.1"), 0);
+    timeval tv{.tv_sec = 1, .tv_usec = 0};
+    ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+  }
+
+  ~Receiver() { ::close(fd_); }
+
+  [[nodiscard]] std::string address() const {
+    return *bits::getSockOptHostPort(fd_);
+  }
+
+  [[nodiscard]] std::string receive() const {
+    std::string buf(65536, '\0');
+    const ssize_t n = ::recv(fd_, buf.data(), buf.size(), 0);
+    buf.resize(n < 0 ? 0 : static_cast<size_t>(n));
+    return buf;
+  }
+
+ private:
+  int fd_;
+};
+}  // namespace
+
+TEST(UdpSinkTest, PacksLinesIntoDatagrams) {
+  Receiver receiver;
+  UdpSink sink(receiver.address(), UdpOptions{.mtu = 64});
+
+  Arena arena;
+  for (int64_t i = 0; i < 10; i++) {
+    arena.begin(intern("metric"), intern("test.udp"),
+                std::chrono::nanoseconds(i));
+    arena.add(intern("value"), i);
+  }
+  sink.publishBatch(arena);
+
+  std::string all;
+  while (all.size() < 10 * std::string("test.udp:0|ms\n").size()) {
+    const auto& datagram = receiver.receive();
+    ASSERT_FALSE(datagram.empty());
+    EXPECT_LE(datagram.size(), 64U);
+    EXPECT_NE(datagram.back(), '\n');
+    all += datagram + "\n";
+  }
+
+  std::string expected;
+  for (int i = 0; i < 10; i++) {
+    expected += "test.udp:" + std::to_string(i) + "|ms\n";
+  }
+  EXPECT_EQ(all, expected);
+  EXPECT_EQ(sink.dropped(), 0U);
+}
+
+TEST(UdpSinkTest, MapsSummariesAndLogs) {
+  Receiver receiver;
+  UdpSink sink(receiver.address(), UdpOptions{.events = true});
+
+  Arena arena;
+  arena.begin(intern("summary"), intern("latency"),
+              std::chrono::nanoseconds(1));
+  arena.add(intern("count"), int64_t{3});
+  arena.add(intern("p99"), 2.5);
+  arena.begin(intern("log"), intern("app"), std::chrono::nanoseconds(2));
+  arena.add(intern("level"), std::string_view("Warn"));
+  arena.add(intern("message"), std::string_view("disk\nfull"));
+  sink.publishBatch(arena);
+
+  EXPECT_EQ(receiver.receive(),
+            "latency.count:3|c\n"
+            "latency.p99:2.5|g\n"
+            "_e{3,10}:app|disk\\nfull|t:warning");
+}
+
+TEST(UdpSinkTest, SkipsLogsAndDropsOversizedLines) {
+  Receiver receiver;
+  UdpSink sink(receiver.address(), UdpOptions{.mtu = 16});
+
+  Arena arena;
+  arena.begin(intern("log"), intern("app"), std::chrono::nanoseconds(1));
+  arena.add(intern("message"), std::string_view("hello"));
+  arena.begin(intern("metric"), intern("a.rather.long.name"),
+              std::chrono::nanoseconds(2));
+  arena.add(intern("value"), int64_t{1});
+  arena.begin(intern("metric"), intern("short"), std::chrono::nanoseconds(3));
+  arena.add(intern("value"), int64_t{7});
+  sink.publishBatch(arena);
+
+  EXPECT_EQ(receiver.receive(), "short:7|ms");
+  EXPECT_EQ(sink.dropped(), 1U);
+}
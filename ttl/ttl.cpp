@@ -1,16 +1,191 @@
 #include "ttl.hpp"
+#include <charconv>
+#include <chrono>
 #include <cstdio>
 #include <cstring>
 #include <format>
+#include <functional>
+#include <map>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "binary_sink.hpp"
 #include "file_sink.hpp"
+#include "prometheus_sink.hpp"
 #include "runtime.hpp"
+#include "shm_sink.hpp"
 #include "sink.hpp"
+#include "tcp_sink.hpp"
+#include "tee_sink.hpp"
+#include "udp_sink.hpp"
+#include "uring_sink.hpp"
 
 namespace bits::ttl {
 
-void Ttl::init(std::string_view uri) {
+namespace {
+// `key=value&key=value` after the first '?' of a connection string.
+using Params = std::map<std::string, std::string, std::less<>>;
+
+std::pair<std::string_view, Params> splitQuery(std::string_view path) {
+  Params params;
+  const auto& q = path.find('?');
+  if (q == std::string_view::npos) {
+    return {path, params};
+  }
+
+  auto query = path.substr(q + 1);
+  while (!query.empty()) {
+    const auto& amp  = query.find('&');
+    const auto& pair = query.substr(0, amp);
+    const auto& eq   = pair.find('=');
+    if (eq == std::string_view::npos) {
+      throw std::invalid_argument(
+          std::format("invalid query parameter: {}", pair));
+    }
+    params.emplace(pair.substr(0, eq), pair.substr(eq + 1));
+    query = amp == std::string_view::npos ? std::string_view{}
+                                          : query.substr(amp + 1);
+  }
+  return {path.substr(0, q), params};
+}
+
+template <typename T>
+T param(const Params& params, std::string_view key, T fallback) {
+  const auto& it = params.find(key);
+  if (it == params.end()) {
+    return fallback;
+  }
+
+  T value{};
+  const auto& s  = it->second;
+  const auto& rc = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (rc.ec != std::errc{} || rc.ptr != s.data() + s.size()) {
+    throw std::invalid_argument(
+        std::format("invalid value for {}: {}", key, s));
+  }
+  return value;
+}
+
+FileOptions fileOptions(const Params& params) {
+  FileOptions options;
+  options.buffer         = param(params, "buffer", options.buffer);
+  options.flush_interval = std::chrono::milliseconds(
+      param(params, "flush_ms", options.flush_interval.count()));
+  options.rotate_bytes    = param(params, "rotate_bytes", options.rotate_bytes);
+  options.rotate_interval = std::chrono::milliseconds(
+      param(params, "rotate_ms", options.rotate_interval.count()));
+  options.retain = param(params, "retain", options.retain);
+  return options;
+}
+
+UringOptions uringOptions(const Params& params) {
+  UringOptions options;
+  options.depth  = param(params, "depth", options.depth);
+  options.buffer = param(params, "buffer", options.buffer);
+  return options;
+}
+
+BinaryOptions binaryOptions(const Params& params) {
+  BinaryOptions options;
+  options.block       = param(params, "block", options.block);
+  options.xor_doubles = param(params, "xor", options.xor_doubles ? 1 : 0) != 0;
+  return options;
+}
+
+ShmOptions shmOptions(const Params& params) {
+  ShmOptions options;
+  options.segment  = param(params, "segment", options.segment);
+  options.segments = param(params, "segments", options.segments);
+  return options;
+}
+
+TcpOptions tcpOptions(const Params& params) {
+  TcpOptions options;
+  options.queue       = param(params, "queue", options.queue);
+  options.backoff_max = std::chrono::milliseconds(
+      param(params, "backoff_ms", options.backoff_max.count()));
+  return options;
+}
+
+UdpOptions udpOptions(const Params& params) {
+  UdpOptions options;
+  options.mtu = param(params, "mtu", options.mtu);
+  if (const auto& type = params.find("type"); type != params.end()) {
+    options.sample_type = type->second;
+  }
+  options.events = param(params, "events", options.events ? 1 : 0) != 0;
+  return options;
+}
+
+PrometheusOptions prometheusOptions(const Params& params) {
+  PrometheusOptions options;
+  options.interval = std::chrono::milliseconds(
+      param(params, "interval_ms", options.interval.count()));
+  options.connections = param(params, "connections", options.connections);
+  return options;
+}
+
+std::unique_ptr<ISink> makeFile(std::string_view path, const Params& params) {
+  const auto& engine = params.find("engine");
+  if (engine == params.end() || engine->second == "sync") {
+    return std::make_unique<File>(path, fileOptions(params));
+  }
+  if (engine->second != "uring") {
+    throw std::invalid_argument(
+        std::format("unsupported engine: {}", engine->second));
+  }
+
+  try {
+    return std::make_unique<UringFile>(path, uringOptions(params));
+  } catch (const std::system_error&) {
+    // No io_uring here (kernel, seccomp, RLIMIT_MEMLOCK): plain writes.
+    // The uring parameters mean nothing to File (`buffer` sized the
+    // registered buffers, not a coalescing threshold), so none carry over.
+    return std::make_unique<File>(path, FileOptions{});
+  }
+}
+TeeOptions teeOptions(const Params& params) {
+  TeeOptions options;
+  options.queue = param(params, "tee_queue", options.queue);
+  if (const auto& drop = params.find("tee_drop"); drop != params.end()) {
+    if (drop->second == "oldest") {
+      options.drop = DropPolicy::Oldest;
+    } else if (drop->second == "newest") {
+      options.drop = DropPolicy::Newest;
+    } else if (drop->second == "block") {
+      options.drop = DropPolicy::Block;
+    } else {
+      throw std::invalid_argument(
+          std::format("invalid value for tee_drop: {}", drop->second));
+    }
+  }
+  return options;
+}
+
+std::unique_ptr<ISink> makeSink(std::string_view uri);
+
+// Children are full connection strings separated by '|'; each may carry
+// tee_queue and tee_drop next to its own parameters.
+std::unique_ptr<ISink> makeTee(std::string_view children) {
+  std::vector<TeeBranch> branches;
+  while (!children.empty()) {
+    const auto& bar   = children.find('|');
+    const auto& child = children.substr(0, bar);
+    const auto& [_, params] = splitQuery(child);
+    branches.push_back({.sink = makeSink(child), .options = teeOptions(params)});
+    children = bar == std::string_view::npos ? std::string_view{}
+                                             : children.substr(bar + 1);
+  }
+  if (branches.empty()) {
+    throw std::invalid_argument("tee needs at least one sink");
+  }
+  return std::make_unique<TeeSink>(std::move(branches));
+}
+
+std::unique_ptr<ISink> makeSink(std::string_view uri) {
   constexpr const auto& p = "://";
   const auto& scheme_end  = uri.find(p);
   if (scheme_end == std::string_view::npos) {
@@ -18,22 +193,54 @@ void Ttl::init(std::string_view uri) {
         std::format("invalid connection string: {}", uri));
   }
 
-  const auto& path   = uri.substr(scheme_end + std::strlen(p));
   const auto& scheme = uri.substr(0, scheme_end);
+  const auto& rest   = uri.substr(scheme_end + std::strlen(p));
+  if (scheme == "tee") {
+    return makeTee(rest);
+  }
 
-  std::unique_ptr<ISink> sink;
+  const auto& [path, params] = splitQuery(rest);
   if (scheme == "file") {
-    sink = std::make_unique<File>(path);
-  } else if (scheme == "stdout") {
-    sink = std::make_unique<StdOut>();
-  } else if (scheme == "discard") {
-    sink = std::make_unique<Discard>();
-  } else {
-    throw std::invalid_argument(std::format("unsupported scheme: {}", scheme));
+    return makeFile(path, params);
+  }
+  if (scheme == "bin") {
+    return std::make_unique<BinaryFile>(path, binaryOptions(params));
+  }
+  if (scheme == "shm") {
+    return std::make_unique<ShmSink>(path, shmOptions(params));
   }
+  if (scheme == "tcp") {
+    return std::make_unique<TcpSink>(path, tcpOptions(params));
+  }
+  if (scheme == "udp") {
+    return std::make_unique<UdpSink>(path, udpOptions(params));
+  }
+  if (scheme == "prometheus") {
+    return std::make_unique<PrometheusSink>(path, prometheusOptions(params));
+  }
+  if (scheme == "stdout") {
+    return std::make_unique<StdOut>();
+  }
+  if (scheme == "discard") {
+    return std::make_unique<Discard>();
+  }
+  throw std::invalid_argument(std::format("unsupported scheme: {}", scheme));
+}
+}  // namespace
 
+// file://<path>[?buffer=<bytes>&flush_ms=<ms>]
+//               [&rotate_bytes=<bytes>&rotate_ms=<ms>&retain=<segments>]
+// bin://<path>[?block=<bytes>&xor=<0|1>]
+// shm://<name>[?segment=<bytes>&segments=<n>]
+// tcp://<ipv4>:<port>[?queue=<bytes>&backoff_ms=<max backoff>]
+// udp://<ipv4>:<port>[?mtu=<bytes>&type=<ms|h|d>&events=<0|1>]
+// prometheus://<ipv4>:<port>[?interval_ms=<ms>&connections=<n>]
+// file://<path>?engine=uring[&depth=<writes>&buffer=<bytes>]
+// tee://<uri>|<uri>... where each <uri> may add
+//               [tee_queue=<batches>&tee_drop=<oldest|newest|block>]
+void Ttl::init(std::string_view uri, RuntimeOptions options) {
   auto rt = detail::Runtime::instance();
-  rt->init(std::move(sink));
+  rt->init(makeSink(uri), options);
 }
 
 void Ttl::shutdown() {
@@ -1,9 +1,21 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
 #include <string_view>
 
 namespace bits::ttl {
 
+struct RuntimeOptions {
+  // Capture interval of objects that do not set their own. Sinks also get
+  // a publishBatch() at least this often, even when nothing is due.
+  // Values below 1ms are raised to 1ms.
+  std::chrono::milliseconds interval{100};
+  // Threads capturing objects in parallel each round, the flush thread
+  // included. Each thread's records reach the sink as a separate batch.
+  size_t collectors = 1;
+};
+
 class Ttl {
  public:
   Ttl()                      = delete;
@@ -12,7 +24,7 @@ class Ttl {
   Ttl& operator=(const Ttl&) = delete;
   Ttl& operator=(Ttl&&)      = delete;
 
-  static void init(std::string_view uri);
+  static void init(std::string_view uri, RuntimeOptions options = {});
   static void shutdown();
 };
 
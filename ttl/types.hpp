@@ -2,14 +2,25 @@
 
 #include <chrono>
 #include <cstdint>
+#include <span>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <variant>
 #include <vector>
+#include "symbols.hpp"
 
 namespace bits::ttl {
 
 using Value = std::variant<int64_t, double, std::string>;
 
+// What a full bounded queue does with a new item.
+enum class DropPolicy {
+  Oldest,  // drop the oldest queued item
+  Newest,  // drop the incoming item
+  Block,   // wait for the consumer to catch up
+};
+
 struct Field {
   std::string key;
   Value value;
@@ -22,4 +33,147 @@ struct Event {
   std::vector<Field> fields;
 };
 
+enum class Kind : uint8_t {
+  Int    = 0,
+  Double = 1,
+  String = 2,
+};
+
+// Slice of Arena's character buffer.
+struct Slice {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct RecordField {
+  Symbol key;
+  Kind kind;
+  union {
+    int64_t i;
+    double d;
+    Slice s;
+  };
+};
+
+// Flat counterpart of Event: names and keys are interned, numbers inline,
+// fields and strings live in the Arena that owns the record.
+struct Record {
+  Symbol type;
+  Symbol name;
+  int64_t timestamp;
+  uint32_t first;
+  uint32_t count;
+};
+
+static_assert(std::is_trivially_copyable_v<RecordField>);
+static_assert(std::is_trivially_copyable_v<Record>);
+
+// Per-flush storage for records. clear() keeps the capacity, so a steady
+// state capture cycle does not allocate.
+class Arena {
+ public:
+  void begin(Symbol type, Symbol name, std::chrono::nanoseconds timestamp) {
+    records_.push_back({.type      = type,
+                        .name      = name,
+                        .timestamp = timestamp.count(),
+                        .first     = static_cast<uint32_t>(fields_.size()),
+                        .count     = 0});
+  }
+
+  void add(Symbol key, int64_t value) {
+    auto& f = push(key, Kind::Int);
+    f.i     = value;
+  }
+
+  void add(Symbol key, double value) {
+    auto& f = push(key, Kind::Double);
+    f.d     = value;
+  }
+
+  // Other integer types would otherwise be ambiguous between the two
+  // overloads above, e.g. add(key, 1).
+  template <typename T>
+    requires(std::is_integral_v<T> && !std::is_same_v<T, int64_t>)
+  void add(Symbol key, T value) {
+    add(key, static_cast<int64_t>(value));
+  }
+
+  void add(Symbol key, std::string_view value) {
+    auto& f = push(key, Kind::String);
+    f.s     = {static_cast<uint32_t>(chars_.size()),
+               static_cast<uint32_t>(value.size())};
+    chars_.insert(chars_.end(), value.begin(), value.end());
+  }
+
+  void clear() noexcept {
+    records_.clear();
+    fields_.clear();
+    chars_.clear();
+  }
+
+  [[nodiscard]] bool empty() const noexcept { return records_.empty(); }
+  [[nodiscard]] size_t size() const noexcept { return records_.size(); }
+
+  [[nodiscard]] std::span<const Record> records() const noexcept {
+    return records_;
+  }
+
+  [[nodiscard]] std::span<const RecordField> fields(
+      const Record& record) const noexcept {
+    return {fields_.data() + record.first, record.count};
+  }
+
+  [[nodiscard]] std::string_view str(const RecordField& field) const noexcept {
+    return {chars_.data() + field.s.offset, field.s.size};
+  }
+
+  // A single-record arena holding `event`, the inverse of toEvent(). For
+  // sinks whose publish(Event&&) goes through publishBatch().
+  [[nodiscard]] static Arena fromEvent(const Event& event) {
+    Arena arena;
+    arena.begin(intern(event.type), intern(event.name), event.timestamp);
+    for (const auto& field : event.fields) {
+      const Symbol key = intern(field.key);
+      std::visit([&](const auto& v) { arena.add(key, v); }, field.value);
+    }
+    return arena;
+  }
+
+  [[nodiscard]] Event toEvent(const Record& record) const {
+    Event event{.type      = std::string(lookup(record.type)),
+                .name      = std::string(lookup(record.name)),
+                .timestamp = std::chrono::nanoseconds(record.timestamp),
+                .fields    = {}};
+    event.fields.reserve(record.count);
+    for (const auto& f : fields(record)) {
+      auto key = std::string(lookup(f.key));
+      switch (f.kind) {
+        case Kind::Int:
+          event.fields.push_back({std::move(key), f.i});
+          break;
+        case Kind::Double:
+          event.fields.push_back({std::move(key), f.d});
+          break;
+        case Kind::String:
+          event.fields.push_back({std::move(key), std::string(str(f))});
+          break;
+      }
+    }
+    return event;
+  }
+
+ private:
+  RecordField& push(Symbol key, Kind kind) {
+    records_.back().count++;
+    auto& f = fields_.emplace_back();
+    f.key   = key;
+    f.kind  = kind;
+    return f;
+  }
+
+  std::vector<Record> records_;
+  std::vector<RecordField> fields_;
+  std::vector<char> chars_;
+};
+
 }  // namespace bits::ttl
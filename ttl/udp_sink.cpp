@@ -0,0 +1,229 @@
+#include "udp_sink.hpp"
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <format>
+#include <stdexcept>
+#include <system_error>
+#include <util.hpp>
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+template <typename T>
+void appendNumber(std::string& out, T v) {
+  char buf[32];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), v);
+  if (ec == std::errc()) {
+    out.append(buf, ptr);
+  }
+}
+
+std::string_view alertType(std::string_view level) {
+  if (level == "Error" || level == "Critical") {
+    return "error";
+  }
+  if (level == "Warn") {
+    return "warning";
+  }
+  return "info";
+}
+}  // namespace
+
+UdpSink::UdpSink(std::string_view address, UdpOptions options)
+    : options_(std::move(options)),
+      metric_(intern("metric")),
+      summary_(intern("summary")),
+      log_(intern("log")),
+      value_(intern("value")),
+      count_(intern("count")),
+      level_(intern("level")),
+      message_(intern("message")) {
+  const auto& parsed = parseAddress(address);
+  if (!parsed) {
+    throw std::invalid_argument(std::format("invalid address: {}", address));
+  }
+
+  fd_ = makeSockUdp();
+  if (fd_ < 0) {
+    throw std::system_error(errno, std::generic_category(),
+                            "ttl: failed to create udp socket");
+  }
+  setSockOptNonBlocking(fd_);
+  // Connected, so sendmmsg() needs no per-message address.
+  if (sockConnect(fd_, parsed->second, parsed->first) != 0) {
+    const int err = errno;
+    ::close(fd_);
+    throw std::system_error(err, std::generic_category(),
+                            std::format("ttl: failed to connect {}", address));
+  }
+}
+
+UdpSink::~UdpSink() {
+  ::close(fd_);
+}
+
+void UdpSink::publish(Event&& event) {
+  publishBatch(Arena::fromEvent(event));
+}
+
+void UdpSink::publish(const Record& record, const Arena& arena) {
+  encode(record, arena);
+  send();
+}
+
+void UdpSink::publishBatch(const Arena& arena) {
+  for (const auto& record : arena.records()) {
+    encode(record, arena);
+  }
+  send();
+}
+
+void UdpSink::encode(const Record& record, const Arena& arena) {
+  const auto name   = lookup(record.name);
+  const auto fields = arena.fields(record);
+
+  if (record.type == log_) {
+    if (!options_.events) {
+      return;
+    }
+    std::string_view level;
+    std::string_view message;
+    for (const auto& f : fields) {
+      if (f.kind != Kind::String) {
+        continue;
+      }
+      if (f.key == level_) {
+        level = arena.str(f);
+      } else if (f.key == message_) {
+        message = arena.str(f);
+      }
+    }
+
+    // Event text may not contain raw newlines.
+    std::string text;
+    text.reserve(message.size());
+    for (const char c : message) {
+      if (c == '\n') {
+        text += "\\n";
+      } else {
+        text.push_back(c);
+      }
+    }
+
+    line_.assign("_e{");
+    appendNumber(line_, name.size());
+    line_.push_back(',');
+    appendNumber(line_, text.size());
+    line_.append("}:");
+    line_.append(name);
+    line_.push_back('|');
+    line_.append(text);
+    line_.append("|t:");
+    line_.append(alertType(level));
+    line(line_);
+    return;
+  }
+
+  for (const auto& f : fields) {
+    if (f.kind == Kind::String) {
+      continue;
+    }
+    if (f.kind == Kind::Double && !std::isfinite(f.d)) {
+      continue;
+    }
+
+    const bool sample = record.type == metric_;
+    if (sample && f.key != value_) {
+      continue;
+    }
+
+    line_.assign(name);
+    if (!sample) {
+      line_.push_back('.');
+      line_.append(lookup(f.key));
+    }
+    line_.push_back(':');
+    if (f.kind == Kind::Int) {
+      appendNumber(line_, f.i);
+    } else {
+      appendNumber(line_, f.d);
+    }
+    line_.push_back('|');
+    if (sample) {
+      line_.append(options_.sample_type);
+    } else {
+      line_.append(record.type == summary_ && f.key == count_ ? "c" : "g");
+    }
+    line(line_);
+  }
+}
+
+void UdpSink::line(std::string_view line) {
+  if (line.size() > options_.mtu) {
+    dropped_++;
+    return;
+  }
+
+  const size_t start = ends_.empty() ? 0 : ends_.back();
+  const size_t size  = out_.size() - start;
+  if (size != 0 && size + 1 + line.size() > options_.mtu) {
+    ends_.push_back(out_.size());
+  }
+  if (out_.size() != (ends_.empty() ? 0 : ends_.back())) {
+    out_.push_back('\n');
+  } else {
+    lines_.push_back(0);
+  }
+  out_.append(line);
+  lines_.back()++;
+}
+
+void UdpSink::send() {
+  if (out_.size() != (ends_.empty() ? 0 : ends_.back())) {
+    ends_.push_back(out_.size());
+  }
+
+  iov_.clear();
+  msgs_.clear();
+  size_t start = 0;
+  for (const size_t end : ends_) {
+    iov_.push_back({.iov_base = out_.data() + start, .iov_len = end - start});
+    start = end;
+  }
+  for (auto& iov : iov_) {
+    mmsghdr m{};
+    m.msg_hdr.msg_iov    = &iov;
+    m.msg_hdr.msg_iovlen = 1;
+    msgs_.push_back(m);
+  }
+
+  size_t done = 0;
+  while (done < msgs_.size()) {
+    const auto n = static_cast<unsigned>(
+        std::min<size_t>(msgs_.size() - done, UIO_MAXIOV));
+    const int sent = ::sendmmsg(fd_, msgs_.data() + done, n, 0);
+    if (sent < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // Full socket buffer or no listener (ECONNREFUSED): drop the rest.
+      for (size_t i = done; i < msgs_.size(); ++i) {
+        dropped_ += lines_[i];
+      }
+      break;
+    }
+    done += static_cast<size_t>(sent);
+  }
+
+  out_.clear();
+  ends_.clear();
+  lines_.clear();
+}
+
+}  // namespace bits::ttl
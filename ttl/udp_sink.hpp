@@ -0,0 +1,74 @@
+#pragma once
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sink.hpp"
+#include "symbols.hpp"
+
+namespace bits::ttl {
+
+struct UdpOptions {
+  // Largest datagram payload; the default fits a 1500 byte Ethernet MTU
+  // with IPv4/UDP headers and some headroom.
+  size_t mtu = 1432;
+  // StatsD type for counter samples: "ms" (timing), "h" or "d".
+  std::string sample_type = "ms";
+  // Send logs as DogStatsD events instead of skipping them.
+  bool events = false;
+};
+
+// Emits StatsD/DogStatsD lines to `host:port` (IPv4):
+//   metric  -> <name>:<value>|<sample_type>
+//   summary -> <name>.count:<n>|c, <name>.<field>:<v>|g for the rest
+//   log     -> _e{<len>,<len>}:<name>|<message>|t:<alert> (with `events`)
+// Lines are packed into datagrams of at most `mtu` bytes and a whole
+// batch goes out with one sendmmsg(). The socket never blocks: what the
+// kernel does not take is dropped and counted.
+class UdpSink : public ISink {
+ public:
+  explicit UdpSink(std::string_view address, UdpOptions options = {});
+  ~UdpSink() override;
+
+  UdpSink(const UdpSink&)            = delete;
+  UdpSink& operator=(const UdpSink&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+
+  // Lines dropped, either too long for a datagram or not accepted by
+  // the socket.
+  [[nodiscard]] size_t dropped() const noexcept { return dropped_; }
+
+ private:
+  void encode(const Record& record, const Arena& arena);
+  void line(std::string_view line);
+  void send();
+
+  int fd_{-1};
+  UdpOptions options_;
+
+  // Packed datagrams back to back, `ends_` marks where each one stops.
+  std::string out_;
+  std::vector<size_t> ends_;
+  std::vector<size_t> lines_;
+  std::string line_;
+  std::vector<iovec> iov_;
+  std::vector<mmsghdr> msgs_;
+  size_t dropped_{0};
+
+  Symbol metric_;
+  Symbol summary_;
+  Symbol log_;
+  Symbol value_;
+  Symbol count_;
+  Symbol level_;
+  Symbol message_;
+};
+
+}  // namespace bits::ttl
@@ -0,0 +1,366 @@
+#include "uring_sink.hpp"
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cerrno>
+#include <cstring>
+#include <format>
+#include <string>
+#include <system_error>
+#include <thread>
+#include "json.hpp"
+#include "types.hpp"
+
+namespace bits::ttl {
+
+namespace {
+int uringSetup(unsigned entries, io_uring_params* params) {
+  return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+int uringEnter(int ring, unsigned submit, unsigned wait, unsigned flags) {
+  return static_cast<int>(
+      ::syscall(__NR_io_uring_enter, ring, submit, wait, flags, nullptr, 0));
+}
+
+int uringRegister(int ring, unsigned op, const void* arg, unsigned n) {
+  return static_cast<int>(::syscall(__NR_io_uring_register, ring, op, arg, n));
+}
+
+// Attempts at a submission the kernel refuses with EAGAIN or EBUSY before
+// falling back to synchronous writes.
+constexpr int kRetries = 100;
+constexpr std::chrono::milliseconds kRetryDelay{1};
+
+unsigned loadAcquire(const unsigned* p) {
+  return std::atomic_ref(*const_cast<unsigned*>(p))
+      .load(std::memory_order_acquire);
+}
+
+void storeRelease(unsigned* p, unsigned v) {
+  std::atomic_ref(*p).store(v, std::memory_order_release);
+}
+
+void* mapRing(int ring, size_t size, off_t offset) {
+  void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, ring, offset);
+  if (p == MAP_FAILED) {
+    throw std::system_error(errno, std::generic_category(),
+                            "ttl: io_uring mmap");
+  }
+  return p;
+}
+}  // namespace
+
+UringFile::UringFile(std::string_view path, UringOptions options)
+    : options_(options) {
+  options_.depth  = std::max<size_t>(options_.depth, 1);
+  options_.buffer = std::max<size_t>(options_.buffer, 4096);
+
+  try {
+    fd_ = ::open(std::string(path).c_str(), O_WRONLY | O_CREAT | O_CLOEXEC,
+                 0644);
+    if (fd_ < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              std::format("ttl: failed to open {}", path));
+    }
+
+    // Writes carry explicit offsets so completions may land in any order.
+    struct stat st{};
+    if (::fstat(fd_, &st) == 0) {
+      offset_ = static_cast<uint64_t>(st.st_size);
+    }
+
+    io_uring_params params{};
+    ring_ = uringSetup(static_cast<unsigned>(options_.depth), &params);
+    if (ring_ < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "ttl: io_uring_setup");
+    }
+
+    sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if ((params.features & IORING_FEAT_SINGLE_MMAP) != 0) {
+      sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+    }
+
+    sq_ptr_ = mapRing(ring_, sq_size_, IORING_OFF_SQ_RING);
+    cq_ptr_ = (params.features & IORING_FEAT_SINGLE_MMAP) != 0
+                  ? sq_ptr_
+                  : mapRing(ring_, cq_size_, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        mapRing(ring_, sqes_size_, IORING_OFF_SQES));
+
+    auto* sq  = static_cast<char*>(sq_ptr_);
+    auto* cq  = static_cast<char*>(cq_ptr_);
+    sq_tail_  = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_  = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    cq_head_  = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_  = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_  = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_     = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+    // One anonymous mapping, registered once so the kernel does not pin
+    // and unpin pages on every write.
+    void* mem = ::mmap(nullptr, options_.depth * options_.buffer,
+                       PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1,
+                       0);
+    if (mem == MAP_FAILED) {
+      throw std::system_error(errno, std::generic_category(),
+                              "ttl: io_uring buffers");
+    }
+    buffers_ = static_cast<char*>(mem);
+
+    std::vector<iovec> iov(options_.depth);
+    for (size_t i = 0; i < options_.depth; ++i) {
+      iov[i] = {.iov_base = buffers_ + i * options_.buffer,
+                .iov_len  = options_.buffer};
+      free_.push_back(static_cast<uint32_t>(options_.depth - 1 - i));
+    }
+    lengths_.resize(options_.depth);
+    offsets_.resize(options_.depth);
+    done_.resize(options_.depth);
+    if (uringRegister(ring_, IORING_REGISTER_BUFFERS, iov.data(),
+                      static_cast<unsigned>(iov.size())) < 0) {
+      throw std::system_error(errno, std::generic_category(),
+                              "ttl: io_uring_register");
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+}
+
+UringFile::~UringFile() {
+  flush();
+  release();
+}
+
+void UringFile::release() noexcept {
+  if (buffers_ != nullptr) {
+    ::munmap(buffers_, options_.depth * options_.buffer);
+  }
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+  }
+  if (cq_ptr_ != nullptr && cq_ptr_ != sq_ptr_) {
+    ::munmap(cq_ptr_, cq_size_);
+  }
+  if (sq_ptr_ != nullptr) {
+    ::munmap(sq_ptr_, sq_size_);
+  }
+  if (ring_ >= 0) {
+    ::close(ring_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  buffers_ = nullptr;
+  sqes_    = nullptr;
+  cq_ptr_  = nullptr;
+  sq_ptr_  = nullptr;
+  ring_    = -1;
+  fd_      = -1;
+}
+
+void UringFile::publish(Event&& event) {
+  staging_.clear();
+  encodeJson(staging_, event);
+  append(staging_);
+  submit();
+}
+
+void UringFile::publish(const Record& record, const Arena& arena) {
+  staging_.clear();
+  encodeJson(staging_, record, arena);
+  append(staging_);
+  submit();
+}
+
+void UringFile::publishBatch(const Arena& arena) {
+  for (const auto& record : arena.records()) {
+    staging_.clear();
+    encodeJson(staging_, record, arena);
+    append(staging_);
+  }
+  submit();
+  reap(false);
+}
+
+void UringFile::flush() {
+  if (ring_ < 0) {
+    return;
+  }
+
+  submit();
+  while (in_flight_ != 0) {
+    reap(true);
+  }
+}
+
+void UringFile::append(std::string_view data) {
+  while (!data.empty()) {
+    if (current_ < 0) {
+      while (free_.empty()) {
+        reap(true);
+      }
+      current_ = free_.back();
+      free_.pop_back();
+      fill_ = 0;
+    }
+
+    char* buf       = buffers_ + static_cast<size_t>(current_) * options_.buffer;
+    const size_t n  = std::min(data.size(), options_.buffer - fill_);
+    std::memcpy(buf + fill_, data.data(), n);
+    fill_ += n;
+    data.remove_prefix(n);
+
+    if (fill_ == options_.buffer) {
+      submit();
+    }
+  }
+}
+
+void UringFile::submit() {
+  if (current_ < 0 || fill_ == 0) {
+    return;
+  }
+
+  const auto index = static_cast<uint32_t>(current_);
+  lengths_[index]  = fill_;
+  offsets_[index]  = offset_;
+  done_[index]     = 0;
+  offset_ += fill_;
+  in_flight_++;
+  current_ = -1;
+  fill_    = 0;
+
+  queue(index);
+  enter();
+}
+
+void UringFile::queue(uint32_t index) {
+  const unsigned tail = *sq_tail_;
+  const unsigned idx  = tail & *sq_mask_;
+  auto& sqe           = sqes_[idx];
+  std::memset(&sqe, 0, sizeof(sqe));
+  sqe.opcode    = IORING_OP_WRITE_FIXED;
+  sqe.fd        = fd_;
+  sqe.addr      = reinterpret_cast<uint64_t>(
+      buffers_ + index * options_.buffer + done_[index]);
+  sqe.len       = static_cast<uint32_t>(lengths_[index] - done_[index]);
+  sqe.off       = offsets_[index] + done_[index];
+  sqe.buf_index = static_cast<uint16_t>(index);
+  sqe.user_data = index;
+  sq_array_[idx] = idx;
+  storeRelease(sq_tail_, tail + 1);
+  pending_++;
+}
+
+void UringFile::enter() {
+  int retries = 0;
+  while (pending_ != 0) {
+    const int n = uringEnter(ring_, pending_, 0, 0);
+    if (n > 0) {
+      pending_ -= static_cast<unsigned>(n);
+      retries = 0;
+      continue;
+    }
+
+    const int err = n < 0 ? errno : EAGAIN;
+    if (err == EINTR) {
+      continue;
+    }
+    // EAGAIN and EBUSY clear once earlier writes complete or the kernel
+    // frees resources, so wait for a completion or briefly back off.
+    if ((err == EAGAIN || err == EBUSY) && retries++ < kRetries) {
+      if (in_flight_ > pending_) {
+        while (uringEnter(ring_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+               errno == EINTR) {
+        }
+        drain();
+      } else {
+        std::this_thread::sleep_for(kRetryDelay);
+      }
+      continue;
+    }
+
+    // The kernel consumed none of the queued entries. Take them back and
+    // write them synchronously so the file is left without holes.
+    unsigned tail = *sq_tail_;
+    for (; pending_ != 0; --pending_) {
+      --tail;
+      const auto index =
+          static_cast<uint32_t>(sqes_[tail & *sq_mask_].user_data);
+      writeSync(index);
+      free_.push_back(index);
+      in_flight_--;
+    }
+    storeRelease(sq_tail_, tail);
+  }
+}
+
+void UringFile::writeSync(uint32_t index) {
+  const char* buf = buffers_ + index * options_.buffer;
+  while (done_[index] < lengths_[index]) {
+    const ssize_t n =
+        ::pwrite(fd_, buf + done_[index], lengths_[index] - done_[index],
+                 static_cast<off_t>(offsets_[index] + done_[index]));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      errors_++;
+      return;
+    }
+    done_[index] += static_cast<size_t>(n);
+  }
+}
+
+void UringFile::reap(bool wait) {
+  if (wait && in_flight_ != 0) {
+    while (uringEnter(ring_, 0, 1, IORING_ENTER_GETEVENTS) < 0 &&
+           errno == EINTR) {
+    }
+  }
+
+  drain();
+  enter();
+}
+
+void UringFile::drain() {
+  unsigned head       = *cq_head_;
+  const unsigned tail = loadAcquire(cq_tail_);
+  for (; head != tail; ++head) {
+    const auto& cqe  = cqes_[head & *cq_mask_];
+    const auto index = static_cast<uint32_t>(cqe.user_data);
+    if (cqe.res > 0) {
+      done_[index] += static_cast<size_t>(cqe.res);
+      // A short write is resubmitted for the remainder at its own
+      // offset; it fails outright on the retry if the cause persists.
+      if (done_[index] < lengths_[index]) {
+        queue(index);
+        continue;
+      }
+    } else if (cqe.res == -EAGAIN || cqe.res == -EINTR) {
+      queue(index);
+      continue;
+    } else {
+      errors_++;
+    }
+    free_.push_back(index);
+    in_flight_--;
+  }
+  storeRelease(cq_head_, head);
+}
+
+}  // namespace bits::ttl
@@ -0,0 +1,96 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "sink.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace bits::ttl {
+
+struct UringOptions {
+  // Registered buffers, i.e. the most writes in flight at once.
+  size_t depth = 8;
+  // Size of each registered buffer.
+  size_t buffer = 256 * 1024;
+};
+
+// File sink that hands writes to io_uring instead of blocking the flush
+// thread on disk. Each capture round is encoded into a registered buffer
+// and submitted as a fixed-buffer write at an explicit offset; the
+// publisher only waits when all `depth` buffers are still in flight.
+//
+// Construction throws std::system_error when io_uring is not available
+// (old kernel, seccomp), callers are expected to fall back to File.
+class UringFile : public ISink {
+ public:
+  explicit UringFile(std::string_view path, UringOptions options = {});
+  ~UringFile() override;
+
+  UringFile(const UringFile&)            = delete;
+  UringFile& operator=(const UringFile&) = delete;
+
+  void publish(Event&& event) override;
+  void publish(const Record& record, const Arena& arena) override;
+  void publishBatch(const Arena& arena) override;
+  // Submits the partial buffer and waits for all writes to complete.
+  void flush() override;
+
+  // Writes that completed with an error since construction.
+  [[nodiscard]] size_t errors() const noexcept { return errors_; }
+
+ private:
+  void append(std::string_view data);
+  void submit();
+  // Queues the unwritten part of buffer `index`.
+  void queue(uint32_t index);
+  // Hands queued writes to the kernel; any it keeps refusing are written
+  // with pwrite() instead.
+  void enter();
+  void writeSync(uint32_t index);
+  void reap(bool wait);
+  // Consumes completions without submitting.
+  void drain();
+  void release() noexcept;
+
+  int fd_{-1};
+  int ring_{-1};
+  UringOptions options_;
+
+  // Shared ring memory.
+  void* sq_ptr_{nullptr};
+  size_t sq_size_{0};
+  void* cq_ptr_{nullptr};
+  size_t cq_size_{0};
+  io_uring_sqe* sqes_{nullptr};
+  size_t sqes_size_{0};
+  unsigned* sq_tail_{nullptr};
+  unsigned* sq_mask_{nullptr};
+  unsigned* sq_array_{nullptr};
+  unsigned* cq_head_{nullptr};
+  unsigned* cq_tail_{nullptr};
+  unsigned* cq_mask_{nullptr};
+  io_uring_cqe* cqes_{nullptr};
+
+  char* buffers_{nullptr};
+  std::vector<uint32_t> free_;
+  // Per buffer: bytes submitted, file offset, and bytes written so far.
+  std::vector<size_t> lengths_;
+  std::vector<uint64_t> offsets_;
+  std::vector<size_t> done_;
+  // Buffer being filled, or -1.
+  int64_t current_{-1};
+  size_t fill_{0};
+  // Buffers owned by the kernel, including queued but not yet entered.
+  size_t in_flight_{0};
+  unsigned pending_{0};
+  uint64_t offset_{0};
+  size_t errors_{0};
+  std::string staging_;
+};
+
+}  // namespace bits::ttl
@@ -8,6 +8,8 @@
 #include <sys/socket.h>
 #include <unistd.h>
 
+#include <array>
+#include <bit>
 #include <cerrno>
 #include <charconv>
 #include <cstdint>
@@ -48,6 +50,10 @@ inline int makeSockTcp() noexcept {
   return ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, IPPROTO_TCP);
 }
 
+inline int makeSockUdp() noexcept {
+  return ::socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, IPPROTO_UDP);
+}
+
 inline int setSockOptNonBlocking(int fd) noexcept {
   const int flags = ::fcntl(fd, F_GETFL, 0);
   if (flags == -1) {
@@ -145,11 +151,14 @@ inline std::optional<std::string> getSockOptHostPort(int fd) noexcept {
 }
 
 constexpr inline uint32_t toNetwork(uint32_t v) noexcept {
-  return htonl(v);
+  if constexpr (std::endian::native == std::endian::little) {
+    return __builtin_bswap32(v);
+  }
+  return v;
 }
 
 constexpr inline uint32_t fromNetwork(uint32_t v) noexcept {
-  return ntohl(v);
+  return toNetwork(v);
 }
 
 std::array<int, 2> inline makePipe() {
@@ -159,19 +168,23 @@ std::array<int, 2> inline makePipe() {
                             "failed to create pipe");
   }
 
-  const int flags = ::fcntl(fds[0], F_GETFL, 0);
-  if (flags == -1) {
-    ::close(fds[0]);
-    ::close(fds[1]);
-    throw std::system_error(errno, std::generic_category(),
-                            "failed to get pipe flags");
-  }
+  // Both ends, so a writer waking a stalled reader never blocks on a
+  // full pipe.
+  for (const int fd : fds) {
+    const int flags = ::fcntl(fd, F_GETFL, 0);
+    if (flags == -1) {
+      ::close(fds[0]);
+      ::close(fds[1]);
+      throw std::system_error(errno, std::generic_category(),
+                              "failed to get pipe flags");
+    }
 
-  if (::fcntl(fds[0], F_SETFL, flags | O_NONBLOCK) == -1) {
-    ::close(fds[0]);
-    ::close(fds[1]);
-    throw std::system_error(errno, std::generic_category(),
-                            "failed to set pipe non-blocking");
+    if (::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+      ::close(fds[0]);
+      ::close(fds[1]);
+      throw std::system_error(errno, std::generic_category(),
+                              "failed to set pipe non-blocking");
+    }
   }
 
   return fds;